@@ -0,0 +1,341 @@
+// Runtime of the programs emitted by --emit-cpp, it is embedded verbatim
+// into every translation unit and follows the semantics of value.hh
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include <ucontext.h>
+
+namespace rt {
+
+struct Value {
+	enum Tag : unsigned char { Udef, Int, Double, Func };
+	Tag tag = Udef;
+	const char *origin = nullptr;
+	union {
+		int i;
+		double d;
+		int f;
+	};
+	Value() : i(0) {
+	}
+	Value(const char *loc, int val) : tag(Int), origin(loc), i(val) {
+	}
+	Value(const char *loc, double val) : tag(Double), origin(loc), d(val) {
+	}
+	static Value func(const char *loc, int id) {
+		Value res;
+		res.tag = Func;
+		res.origin = loc;
+		res.f = id;
+		return res;
+	}
+};
+
+struct TypeError {
+	std::string what;
+	const char *at;
+};
+
+[[noreturn]] inline void incorrect(const char *origin, const char *at) {
+	throw TypeError{std::string{"Value of incorrect type declared at "} + origin, at};
+}
+
+[[noreturn]] inline void udef(const char *at) {
+	throw TypeError{"Undefined value", at};
+}
+
+template <typename T>
+T get(const Value &val, const char *at) {
+	switch (val.tag) {
+	case Value::Int:
+		return val.i;
+	case Value::Double:
+		return static_cast<T>(val.d);
+	case Value::Func:
+		incorrect(val.origin, at);
+	default:
+		udef(at);
+	}
+}
+
+inline bool truth(const Value &val, const char *at) {
+	return get<int>(val, at);
+}
+
+template <template <typename> typename F, bool int_only = false>
+Value binop(const Value &lhs, const Value &rhs, const char *loc) {
+	if constexpr (!int_only)
+		if (lhs.tag == Value::Double || rhs.tag == Value::Double) {
+			auto origin = (lhs.tag == Value::Double ? lhs : rhs).origin;
+			return {origin, static_cast<double>(F<double>{}(get<double>(lhs, loc), get<double>(rhs, loc)))};
+		}
+	if (lhs.tag == Value::Int || rhs.tag == Value::Int) {
+		auto origin = (lhs.tag == Value::Int ? lhs : rhs).origin;
+		return {origin, static_cast<int>(F<int>{}(get<int>(lhs, loc), get<int>(rhs, loc)))};
+	}
+	incorrect(loc, loc);
+}
+
+template <template <typename> typename F, bool int_only = false>
+Value unop(const Value &val, const char *loc) {
+	if constexpr (!int_only)
+		if (val.tag == Value::Double)
+			return {val.origin, static_cast<double>(F<double>{}(val.d))};
+	if (val.tag == Value::Int)
+		return {val.origin, static_cast<int>(F<int>{}(val.i))};
+	incorrect(loc, loc);
+}
+
+template <typename T>
+struct Plus {
+	auto operator() (T a) { return +a; }
+};
+
+template <typename T>
+struct Print {
+	auto operator() (T a) {
+		std::cout << a << std::endl;
+		return a;
+	}
+};
+
+// the absolute value of an int in unsigned, where INT_MIN has one too
+inline unsigned magnitude(int a) {
+	return a < 0 ? 0u - static_cast<unsigned>(a) : a;
+}
+
+template <typename T>
+struct Abs {
+	T operator() (T a) { return std::abs(a); }
+};
+
+// abs(INT_MIN) wraps around to INT_MIN
+template <>
+struct Abs<int> {
+	int operator() (int a) { return magnitude(a); }
+};
+
+template <typename T>
+struct Sqrt {
+	T operator() (T a) { return std::sqrt(a); }
+};
+
+template <>
+struct Sqrt<int> {
+	int operator() (int a) { return a > 0 ? static_cast<int>(std::sqrt(static_cast<double>(a))) : 0; }
+};
+
+template <typename T>
+struct Min {
+	T operator() (T a, T b) { return b < a ? b : a; }
+};
+
+template <typename T>
+struct Max {
+	T operator() (T a, T b) { return a < b ? b : a; }
+};
+
+template <typename T>
+struct Gcd {
+	T operator() (T a, T b) { return std::gcd(magnitude(a), magnitude(b)); }
+};
+
+template <typename T>
+struct Pow {
+	T operator() (T a, T b) { return std::pow(a, b); }
+};
+
+template <>
+struct Pow<int> {
+	int operator() (int a, int b) {
+		if (b < 0)
+			return a == 1 ? 1 : a == -1 ? (b % 2 ? -1 : 1) : 0;
+		unsigned res = 1;
+		for (unsigned base = a; b; b >>= 1, base *= base)
+			if (b & 1)
+				res *= base;
+		return res;
+	}
+};
+
+template <typename T>
+struct Shl {
+	T operator() (T a, T b) { return static_cast<unsigned>(a) << (b & 31); }
+};
+
+template <typename T>
+struct Shr {
+	T operator() (T a, T b) { return a >> (b & 31); }
+};
+
+inline Value read(const char *loc) {
+	int val;
+	std::cin >> val;
+	if (std::cin.fail())
+		return {};
+	return {loc, val};
+}
+
+struct Vars {
+	std::vector<std::pair<int, Value>> vars;
+	Value *find(int sym) {
+		for (auto &&var : vars)
+			if (var.first == sym)
+				return &var.second;
+		return nullptr;
+	}
+	void set(int sym, const Value &val) {
+		if (auto var = find(sym))
+			*var = val;
+		else
+			vars.emplace_back(sym, val);
+	}
+	void emplace(int sym, const Value &val) {
+		if (!find(sym))
+			vars.emplace_back(sym, val);
+	}
+};
+
+struct Env;
+
+struct Function {
+	Value (*code)(Env &);
+	std::size_t arity;
+	const int *params;
+};
+
+struct Env {
+	Vars *globals;
+	// read when a name is not a variable, never assigned
+	Vars *builtins;
+	const Function *funcs;
+	std::vector<Vars> locals;
+	// calls the function is nested in
+	unsigned depth;
+	// location of the call, the errors of an intrinsic are reported there
+	const char *at;
+
+	void push() {
+		locals.emplace_back();
+	}
+	void pop() {
+		locals.pop_back();
+	}
+	Value *find(int sym) {
+		for (auto it = locals.rbegin(), end = locals.rend(); it != end; ++it)
+			if (auto var = it->find(sym))
+				return var;
+		return globals->find(sym);
+	}
+	Value get(int sym) {
+		auto var = find(sym);
+		if (!var)
+			var = builtins->find(sym);
+		return var ? *var : Value{};
+	}
+	void set(int sym, const Value &val) {
+		if (auto var = find(sym))
+			*var = val;
+		else
+			(locals.empty() ? *globals : locals.back()).vars.emplace_back(sym, val);
+	}
+	void set_global(int sym, const Value &val) {
+		globals->set(sym, val);
+	}
+	void set_builtin(int sym, const Value &val) {
+		builtins->set(sym, val);
+	}
+};
+
+// every this many nested calls continue on a stack of their own, so the
+// depth of the recursion is limited by the heap as in the interpreter
+constexpr unsigned max_depth = 256;
+constexpr std::size_t stack_size = 16 << 20;
+
+struct Deep {
+	Env *env;
+	const Function *fn;
+	Value res;
+	std::exception_ptr err;
+	ucontext_t caller;
+};
+
+// the call the next stack starts with
+inline Deep *pending = nullptr;
+// kept for the next recursion as deep, the n-th one runs the calls
+// starting at the depth (n + 1) * max_depth
+inline std::vector<std::unique_ptr<char[]>> stacks;
+
+inline void start_deep() {
+	auto &&call = *pending;
+	try {
+		call.res = call.fn->code(*call.env);
+	} catch (...) {
+		// an exception does not leave the stack it is thrown on
+		call.err = std::current_exception();
+	}
+}
+
+inline Value deep(Env &env, const Function &fn) {
+	auto n = env.depth / max_depth - 1;
+	if (n == stacks.size())
+		stacks.emplace_back(new char[stack_size]);
+	Deep call{&env, &fn, {}, {}, {}};
+	ucontext_t ctx;
+	getcontext(&ctx);
+	ctx.uc_stack.ss_sp = stacks[n].get();
+	ctx.uc_stack.ss_size = stack_size;
+	ctx.uc_link = &call.caller;
+	makecontext(&ctx, start_deep, 0);
+	pending = &call;
+	swapcontext(&call.caller, &ctx);
+	if (call.err)
+		std::rethrow_exception(call.err);
+	return call.res;
+}
+
+inline Value call(Env &env, const Value &func, Value *args, std::size_t n, const char *at) {
+	if (func.tag == Value::Udef)
+		udef(at);
+	if (func.tag != Value::Func)
+		incorrect(func.origin, at);
+	auto &&fn = env.funcs[func.f];
+	if (n != fn.arity)
+		throw std::logic_error("Incorrect number of arguments");
+	Env callee{env.globals, env.builtins, env.funcs, {}, env.depth + 1, at};
+	callee.push();
+	auto &&params = callee.locals.back();
+	// arguments come in evaluation order, that is starting from the last one
+	for (std::size_t i = 0; i < n; ++i)
+		params.emplace(fn.params[i], args[n - 1 - i]);
+	if (callee.depth % max_depth)
+		return fn.code(callee);
+	return deep(callee, fn);
+}
+
+inline int main(Value (*run)(Env &), const Function *funcs) {
+	Vars globals;
+	Vars builtins;
+	Env env{&globals, &builtins, funcs, {}, 0, nullptr};
+	try {
+		run(env);
+	} catch (const TypeError &err) {
+		std::cout << "Type error: " << err.what << " is used at " << err.at << std::endl;
+	} catch (const std::logic_error &err) {
+		std::cout << "Semantic error: " << err.what() << std::endl;
+	} catch (const std::bad_alloc &ba) {
+		std::cout << "Context is too large: " << ba.what() << std::endl;
+	}
+	return 0;
+}
+}
@@ -1,29 +1,118 @@
 #include "ast.hh"
+#include "exec.hh"
 #include "value.hh"
-#include <cassert>
 
 namespace AST {
 
-void exec(const INode *root) {
-	auto expr = static_cast<const Expr *>(root);
-	Context ctxt;
-	ctxt.call_stack.emplace_back();
+void walk(const INode *root) {
+	Governor gov;
+	walk(root, gov);
+}
+
+bool walk(const INode *root, Governor &gov) {
+	if (!gov.sched) {
+		gov.sched = std::make_unique<Scheduler>();
+		gov.sched->countdown = gov.start();
+		gov.sched->gov = &gov;
+		gov.sched->spawn(static_cast<const Expr *>(root));
+	}
+	auto &&sched = *gov.sched;
 	try {
-		while (expr) {
-			auto tmp = expr->eval(ctxt);
-			ctxt.prev = expr;
-			expr = tmp;
-		}
-		assert(ctxt.res.size() == 1);
-		assert(ctxt.call_stack.size() == 1);
-		assert(ctxt.ctxts_stack.size() == 0);
+		if (!sched.run())
+			return false;
 	} catch (const Values::ValueExcept& err) {
-		std::cout << "Type error: " << err << " is used at " << expr->loc_ << std::endl;
+		std::cout << "Type error: " << err << " is used at " << sched.current->ctxt.fault->loc_ << std::endl;
 	} catch (const std::logic_error& err) {
 		std::cout << "Semantic error: " << err.what() << std::endl;
+	} catch (const Context::Exceeded &err) {
+		std::cout << "Limit exceeded: " << err.what() << std::endl;
 	} catch (const std::bad_alloc& ba) {
 		std::cout << "Context is too large: " << ba.what() << std::endl;
 	}
+	if (Tracer::report)
+		sched.tracer.print(std::cerr);
+	gov.sched.reset();
+	return true;
+}
+
+void Context::walk(const Expr *expr) {
+	try {
+		for (;;) {
+			if (recording)
+				while (expr && recording) {
+					if (!expr->record(*recording, *this))
+						tracer->abort(*this);
+					auto tmp = expr->eval(*this);
+					prev = expr;
+					expr = tmp;
+				}
+			else
+				while (expr) {
+					auto tmp = expr->eval(*this);
+					prev = expr;
+					expr = tmp;
+				}
+			if (!expr && exit_node) {
+				prev = exit_prev;
+				expr = std::exchange(exit_node, nullptr);
+			}
+			if (!expr)
+				break;
+		}
+	} catch (const Values::ValueExcept &) {
+		fault = expr;
+		throw;
+	}
+}
+
+Value Context::read(LocT loc) {
+	if (io && io->input) {
+		auto val = io->input();
+		return val ? Value{loc, *val} : Value{};
+	}
+	int val;
+	std::cin >> val;
+	if (std::cin.fail())
+		return Value{};
+	return Value{loc, val};
+}
+
+bool Context::print(const Value &val) {
+	Number num;
+	if (val.isSameType<int>())
+		num = static_cast<int>(val);
+	else if (val.isSameType<double>())
+		num = static_cast<double>(val);
+	else
+		return false;
+	if (io && io->print)
+		io->print(num);
+	else
+		std::visit([](auto val) {
+			std::cout << val << std::endl;
+		}, num);
+	return true;
+}
+
+Value *Context::import(const std::string &name) {
+	for (auto it = imports.rbegin(), end = imports.rend(); it != end; ++it)
+		if (auto func = (*it)->func(name))
+			return &(scope_stack.front()[name] = Value{func->loc_, func->func()});
+	return nullptr;
+}
+
+bool Context::imported(const std::string &name) const {
+	return std::any_of(imports.begin(), imports.end(), [&](auto &&module) {
+		return module->func(name);
+	});
+}
+
+void Context::open(Module *module) {
+	auto &&globals = scope_stack.front();
+	for (auto it = globals.begin(); it != globals.end();)
+		it = module->func(it->first) ? globals.erase(it) : std::next(it);
+	imports.erase(std::remove(imports.begin(), imports.end(), module), imports.end());
+	imports.push_back(module);
 }
 
 const Expr *Empty::eval(Context &ctxt) const {
@@ -61,11 +150,17 @@ const Expr *While::eval(Context &ctxt) const {
 		return expr_.get();
 	if (ctxt.prev == block_.get()) {
 		ctxt.res.pop_back();
+		if (ctxt.tracer)
+			return replay(ctxt);
 		return expr_.get();
 	}
-	bool flag = ctxt.res.back();
+	bool flag = truth(ctxt.res.back(), expr_->type_);
 	if (flag && block_) {
 		ctxt.res.pop_back();
+		if (ctxt.tick()) {
+			ctxt.resume = block_.get();
+			return nullptr;
+		}
 		return block_.get();
 	}
 	return parent_;
@@ -75,7 +170,7 @@ const Expr *If::eval(Context &ctxt) const {
 	if (ctxt.prev == parent_)
 		return expr_.get();
 	if (ctxt.prev == expr_.get()) {
-		bool flag = ctxt.res.back();
+		bool flag = truth(ctxt.res.back(), expr_->type_);
 		ctxt.res.pop_back();
 		if (flag)
 			return true_block_.get();
@@ -104,6 +199,14 @@ const Expr *ExprId::eval(Context &ctxt) const {
 			return parent_;
 		}
 	}
+	if (auto var = ctxt.import(name_)) {
+		ctxt.res.push_back(*var);
+		return parent_;
+	}
+	if (auto var = ctxt.builtins.find(name_); var != ctxt.builtins.end()) {
+		ctxt.res.push_back(var->second);
+		return parent_;
+	}
 	ctxt.res.emplace_back();
 	return parent_;
 }
@@ -135,29 +238,31 @@ const Expr *ExprFunc::eval(Context &ctxt) const {
 }
 
 const Expr *ExprApply::eval(Context &ctxt) const {
-	if (ctxt.prev == parent_) {
-		if (ops_)
-			return ops_.get();
+	if (ctxt.prev == parent_ && ops_)
+		return ops_.get();
+	if (ctxt.prev == parent_ || ctxt.prev == ops_.get()) {
+		// a bound call goes to its function without looking up the name, an
+		// intrinsic works on the arguments where they are
+		if (target_ && target_->intrinsic_) {
+			target_->intrinsic_->eval(ctxt, this);
+			return parent_;
+		}
+		if (target_)
+			return start(ctxt, target_->func());
 		return id_.get();
 	}
-	if (ctxt.prev == ops_.get())
-		return id_.get();
 	if (ctxt.prev == id_.get()) {
-		ctxt.ctxts_stack.emplace_back(std::move(ctxt.scope_stack));
-		ctxt.scope_stack = {ctxt.ctxts_stack.back().front(), VarsT{}};
-		ctxt.call_stack.emplace_back(this);
-
-		Func func = ctxt.res.back();
+		auto &&top = ctxt.res.back();
+		Func func = id_->type_.bits == Types::Func ? top.get<Func>() : static_cast<Func>(top);
 		ctxt.res.pop_back();
 		if ((ops_ ? ops_->size() : 0) != func.decls_->size())
 			throw std::logic_error("Incorrect number of arguments");
-		auto &&func_scope = ctxt.scope_stack.back();
-		auto res_it = ctxt.res.rbegin();
-		for (auto it = func.decls_->cbegin(), end = func.decls_->cend(); it != end; ++it)
-			func_scope.emplace(*it, *res_it++);
-		ctxt.res.erase(res_it.base(), ctxt.res.end());
-		
-		return func.body_;
+		// an intrinsic reports errors at the call as it does when bound
+		if (auto op = intrinsic(func)) {
+			op->eval(ctxt, this);
+			return parent_;
+		}
+		return start(ctxt, func);
 	}
 	ctxt.ctxts_stack.back().front() = std::move(ctxt.scope_stack.front());
 	ctxt.scope_stack = std::move(ctxt.ctxts_stack.back());
@@ -166,13 +271,91 @@ const Expr *ExprApply::eval(Context &ctxt) const {
 	return parent_;
 }
 
-const Expr *ExprQmark::eval(Context &ctxt) const {
-	int val;
-	std::cin >> val;
-	if (std::cin.fail())
-		ctxt.res.emplace_back();
+const Expr *ExprApply::start(Context &ctxt, const Func &func) const {
+	ctxt.ctxts_stack.emplace_back(std::move(ctxt.scope_stack));
+	ctxt.scope_stack = {ctxt.ctxts_stack.back().front(), VarsT{}};
+	ctxt.call_stack.emplace_back(this);
+
+	auto &&func_scope = ctxt.scope_stack.back();
+	auto res_it = ctxt.res.rbegin();
+	for (auto it = func.decls_->cbegin(), end = func.decls_->cend(); it != end; ++it)
+		func_scope.emplace(*it, *res_it++);
+	ctxt.res.erase(res_it.base(), ctxt.res.end());
+	ctxt.enter(ctxt.depth + ctxt.ctxts_stack.size());
+	if (ctxt.tick()) {
+		ctxt.resume = func.body_;
+		return nullptr;
+	}
+	return func.body_;
+}
+
+const Expr *Import::eval(Context &ctxt) const {
+	if (module_->builtin)
+		for (auto &&func : module_->loaded())
+			func->define(ctxt.builtins);
 	else
-		ctxt.res.emplace_back(loc_, val);
+		ctxt.open(module_);
+	ctxt.res.emplace_back();
+	return parent_;
+}
+
+const Expr *ExprNative::eval(Context &ctxt) const {
+	ctxt.res.push_back(call(ctxt));
+	return parent_;
+}
+
+const Expr *Spawn::eval(Context &ctxt) const {
+	if (ctxt.prev == parent_) {
+		if (ops_)
+			return ops_.get();
+		return id_.get();
+	}
+	if (ctxt.prev == ops_.get())
+		return id_.get();
+	auto &&top = ctxt.res.back();
+	Func func = id_->type_.bits == Types::Func ? top.get<Func>() : static_cast<Func>(top);
+	ctxt.res.pop_back();
+	if ((ops_ ? ops_->size() : 0) != func.decls_->size())
+		throw std::logic_error("Incorrect number of arguments");
+	auto &&task = ctxt.sched->spawn(func.body_);
+	task.ctxt.builtins = ctxt.builtins;
+	task.ctxt.imports = ctxt.imports;
+	auto &&scopes = task.ctxt.scope_stack = {ctxt.scope_stack.front(), VarsT{}};
+	auto res_it = ctxt.res.rbegin();
+	for (auto it = func.decls_->cbegin(), end = func.decls_->cend(); it != end; ++it)
+		scopes.back().emplace(*it, std::move(*res_it++));
+	ctxt.res.erase(res_it.base(), ctxt.res.end());
+	ctxt.res.emplace_back(loc_, task.id);
+	return parent_;
+}
+
+const Expr *Yield::eval(Context &ctxt) const {
+	ctxt.res.emplace_back();
+	ctxt.resume = parent_;
+	return nullptr;
+}
+
+const Expr *Join::eval(Context &ctxt) const {
+	if (ctxt.prev == parent_)
+		return expr_.get();
+	// the id stays on res while the task is waited for
+	auto id = static_cast<int>(ctxt.res.back());
+	if (auto res = ctxt.sched->result(id)) {
+		ctxt.res.back() = *res;
+		return parent_;
+	}
+	ctxt.sched->wait(id);
+	ctxt.resume = this;
+	return nullptr;
+}
+
+const Expr *ExprQmark::eval(Context &ctxt) const {
+	// input that is not there yet lets the other tasks run
+	if (ctxt.sched && ctxt.sched->busy() && !Scheduler::input_ready()) {
+		ctxt.resume = this;
+		return nullptr;
+	}
+	ctxt.res.push_back(ctxt.read(loc_));
 	return parent_;
 }
 
@@ -188,7 +371,11 @@ const Expr *ExprAssign::eval(Context &ctxt) const {
 		}
 		return true;
 	};
-	if (std::all_of(ctxt.scope_stack.rbegin(), ctxt.scope_stack.rend(), pred))
+	if (!std::all_of(ctxt.scope_stack.rbegin(), ctxt.scope_stack.rend(), pred))
+		return parent_;
+	if (auto var = ctxt.import(name))
+		*var = std::move(val);
+	else
 		ctxt.scope_stack.back()[name] = std::move(val);
 	return parent_;
 }
@@ -1,5 +1,12 @@
 #pragma once
 #include "value.hh"
+#include "types.hh"
+#include "inliner.hh"
+#include "binder.hh"
+#include "trace.hh"
+#include "host.hh"
+#include "emitter.hh"
+#include "module.hh"
 #include <string>
 #include <unordered_map>
 #include <utility>
@@ -7,12 +14,19 @@
 #include <functional>
 #include <memory>
 #include <iostream>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include <type_traits>
 
 namespace AST {
 
 using VarsT = std::unordered_map<std::string, Value>;
 
 struct Expr;
+struct Intrinsic;
+struct Scheduler;
+struct Governor;
 
 struct INode {
 	Expr *parent_ = nullptr;
@@ -22,18 +36,127 @@ struct INode {
 
 struct Context {
 	using ScopeStackT = std::vector<VarsT>;
+	// calls nested deeper than this are run by the tree walker
+	static constexpr unsigned max_depth = 256;
 	ScopeStackT scope_stack;
+	// functions of the builtin modules, read when a name is not a variable
+	VarsT builtins;
+	// modules imported so far, the last one first; their functions become
+	// globals when they are first looked up
+	std::vector<Module *> imports;
 	std::vector<const Expr *> call_stack;
 	std::vector<ScopeStackT> ctxts_stack;
 	const Expr *prev = nullptr;
 	std::vector<Value> res;
+	bool returning = false;
+	unsigned depth = 0;
+	// scopes of the running function start here, the ones below
+	// belong to its callers and only the globals are visible
+	std::size_t frame = 1;
+	const Expr *fault = nullptr;
+	// coroutines of the walked program, a suspended one continues at resume
+	Scheduler *sched = nullptr;
+	const Expr *resume = nullptr;
+	// loop iterations and calls left until the governor looks again
+	Governor *gov = nullptr;
+	std::size_t countdown = -1;
+	std::size_t max_calls = -1;
+	// hot loops of the walker, a trace that stops in the middle of its loop
+	// leaves the node the walk goes on with
+	Tracer *tracer = nullptr;
+	Trace *recording = nullptr;
+	const Expr *exit_prev = nullptr;
+	const Expr *exit_node = nullptr;
+	// callbacks of a host program for ? and print
+	const IO *io = nullptr;
+	void walk(const Expr *expr);
+	Value read(LocT loc);
+	// false when the value is not a number
+	bool print(const Value &val);
+	// counts a step, true when the time slice is over
+	bool tick() {
+		return --countdown == 0 && expire();
+	}
+	bool expire();
+	void enter(std::size_t calls) const {
+		if (calls > max_calls)
+			throw Exceeded("calls nested deeper than " + std::to_string(max_calls));
+	}
+	Value *find(const std::string &name) {
+		for (auto i = scope_stack.size(); i-- > frame;) {
+			auto var = scope_stack[i].find(name);
+			if (var != scope_stack[i].end())
+				return &var->second;
+		}
+		auto var = scope_stack.front().find(name);
+		return var == scope_stack.front().end() ? import(name) : &var->second;
+	}
+	// defines the global of an imported function on its first use
+	Value *import(const std::string &name);
+	bool imported(const std::string &name) const;
+	// the globals the module defines are dropped, their names read its functions
+	void open(Module *module);
+	// assignments go to find(), they never reach the builtins
+	Value *lookup(const std::string &name) {
+		if (auto var = find(name))
+			return var;
+		auto var = builtins.find(name);
+		return var == builtins.end() ? nullptr : &var->second;
+	}
+
+	// return from inside an expression, caught by the enclosing scope
+	struct Unwind {
+		Value res;
+	};
+	// thrown by nodes closures cannot suspend, such programs are walked
+	struct Suspends {};
+	// a limit of the governor is reached
+	struct Exceeded : std::runtime_error {
+		using std::runtime_error::runtime_error;
+	};
 };
 
+// Closure an expression is compiled to, it returns the value of the expression
+using Code = std::function<Value (Context &)>;
+
+inline bool truth(Value &val, const Types &t) {
+	if (t.bits == Types::Int)
+		return val.get<int>();
+	if (t.bits == Types::Double)
+		return static_cast<int>(val.get<double>());
+	return val;
+}
+
 struct Expr : public INode {
 	LocT loc_;
+	Types type_;
 	Expr(LocT loc) : loc_(loc) {
 	}
 	virtual const Expr *eval(Context &ctxt) const = 0;
+	virtual Types infer(Infer &in) = 0;
+	virtual void dump(std::ostream &os, int depth) const = 0;
+	virtual void scan(Inliner::Info &info) const = 0;
+	virtual Expr *clone(const Inliner::Renames &names) const = 0;
+	virtual void inline_calls(Inliner &in) = 0;
+	virtual void emit(Emitter &em, const std::string &dest) const = 0;
+	virtual Code compile() = 0;
+	virtual void save(Writer &out) const = 0;
+	virtual Expr *expand(Inliner &in) {
+		return nullptr;
+	}
+	// leaves neither write names nor call
+	virtual void bind(Binder &bd) {
+	}
+	// adds what the walker is about to do to the trace, false when it cannot
+	virtual bool record(Trace &tr, Context &ctxt) const {
+		return false;
+	}
+	// whether the node hands a return from the child on to its parent
+	virtual bool passes_return(const Expr *child) const {
+		return false;
+	}
+	Types analyze(Infer &in);
+	void dump_head(std::ostream &os, int depth, const std::string &name) const;
 };
 
 struct DeclList : public INode {
@@ -58,44 +181,98 @@ struct ExprList : public Expr {
 private:
 	std::unique_ptr<ExprList> tail_;
 	std::unique_ptr<Expr> head_;
+	std::size_t size_;
 public:
 	ExprList(LocT loc, INode *tail, INode *head) :
 		Expr(loc),
 		tail_(static_cast<ExprList *>(tail)),
-		head_(static_cast<Expr *>(head))
+		head_(static_cast<Expr *>(head)),
+		size_(tail_ ? tail_->size_ + 1 : 1)
 	{
 		head_->parent_ = this;
 		if (tail_)
 			tail_->parent_ = this;
 	}
+	~ExprList() {
+		// unlink the tails one by one instead of recursing into them
+		while (tail_)
+			tail_ = std::move(tail_->tail_);
+	}
 	const Expr *eval(Context &ctxt) const override;
+	Types infer(Infer &in) override;
+	void dump(std::ostream &os, int depth) const override;
+	void scan(Inliner::Info &info) const override;
+	Expr *clone(const Inliner::Renames &names) const override;
+	void inline_calls(Inliner &in) override;
+	void emit(Emitter &em, const std::string &dest) const override;
+	Code compile() override;
+	void save(Writer &out) const override;
+	void bind(Binder &bd) override;
 	std::size_t size() const {
-		return tail_ ? (tail_->size() + 1) : 1;
+		return size_;
 	}
+	void infer_args(Infer &in, std::vector<Types> &args);
+	void release(std::vector<std::unique_ptr<Expr>> &args);
+	void emit_args(Emitter &em, const std::string &args) const;
+	void compile_args(std::vector<Code> &args);
+	void arg_types(std::vector<Types> &types) const;
+	bool record(Trace &tr, Context &ctxt) const override;
 };
 
 struct Empty : public Expr {
 	Empty(LocT loc) : Expr(loc) {}
 	const Expr *eval(Context &ctxt) const override;
+	Types infer(Infer &in) override;
+	void dump(std::ostream &os, int depth) const override;
+	void scan(Inliner::Info &info) const override;
+	Expr *clone(const Inliner::Renames &names) const override;
+	void inline_calls(Inliner &in) override;
+	void emit(Emitter &em, const std::string &dest) const override;
+	Code compile() override;
+	void save(Writer &out) const override;
+	bool record(Trace &tr, Context &ctxt) const override;
 };
 
 struct Scope : public Expr {
 private:
 	std::unique_ptr<Expr> blocks_;
 public:
+	// set for function bodies, called by ExprApply
+	Code code_;
+	Expr *blocks() {
+		return blocks_.get();
+	}
 	Scope(LocT loc, INode *blocks) :
 		Expr(loc),
 		blocks_(static_cast<Expr *>(blocks))
 	{
 		blocks->parent_ = this;
 	}
-	const Expr *eval(Context &ctxt) const override; 
+	const Expr *eval(Context &ctxt) const override;
+	Types infer(Infer &in) override;
+	void dump(std::ostream &os, int depth) const override;
+	void scan(Inliner::Info &info) const override;
+	Expr *clone(const Inliner::Renames &names) const override;
+	void inline_calls(Inliner &in) override;
+	void emit(Emitter &em, const std::string &dest) const override;
+	Code compile() override;
+	void save(Writer &out) const override;
+	bool record(Trace &tr, Context &ctxt) const override;
+	void bind(Binder &bd) override;
 };
 
 struct Seq : public Expr {
 private:
 	std::unique_ptr<Expr> fst_;
 	std::unique_ptr<Expr> snd_;
+	// sequences nested to the left of seq, starting with seq itself
+	template <typename T>
+	static std::vector<T *> chain(T *seq) {
+		std::vector<T *> res{seq};
+		while (auto fst = dynamic_cast<T *>(res.back()->fst_.get()))
+			res.push_back(fst);
+		return res;
+	}
 public:
 	Seq(LocT loc, INode *fst, INode *snd) :
 		Expr(loc),
@@ -104,7 +281,25 @@ public:
 	{
 		fst_->parent_ = snd_->parent_ = this;
 	}
-	const Expr *eval(Context &ctxt) const override; 
+	~Seq() {
+		// the chain is as long as the program, unlink it instead of recursing
+		while (auto fst = dynamic_cast<Seq *>(fst_.get()))
+			fst_ = std::move(fst->fst_);
+	}
+	const Expr *eval(Context &ctxt) const override;
+	Types infer(Infer &in) override;
+	void dump(std::ostream &os, int depth) const override;
+	void scan(Inliner::Info &info) const override;
+	Expr *clone(const Inliner::Renames &names) const override;
+	void inline_calls(Inliner &in) override;
+	void emit(Emitter &em, const std::string &dest) const override;
+	Code compile() override;
+	void save(Writer &out) const override;
+	bool record(Trace &tr, Context &ctxt) const override;
+	void bind(Binder &bd) override;
+	bool passes_return(const Expr *child) const override {
+		return true;
+	}
 };
 
 struct While : public Expr {
@@ -120,6 +315,20 @@ public:
 		expr_->parent_ = block_->parent_ = this;
 	}
 	const Expr *eval(Context &ctxt) const override;
+	Types infer(Infer &in) override;
+	void dump(std::ostream &os, int depth) const override;
+	void scan(Inliner::Info &info) const override;
+	Expr *clone(const Inliner::Renames &names) const override;
+	void inline_calls(Inliner &in) override;
+	void emit(Emitter &em, const std::string &dest) const override;
+	Code compile() override;
+	void save(Writer &out) const override;
+	bool record(Trace &tr, Context &ctxt) const override;
+	void bind(Binder &bd) override;
+	bool passes_return(const Expr *child) const override {
+		return child == block_.get();
+	}
+	const Expr *replay(Context &ctxt) const;
 };
 
 struct If : public Expr {
@@ -139,6 +348,19 @@ public:
 			false_block_->parent_ = this;
 	}
 	const Expr *eval(Context &ctxt) const override;
+	Types infer(Infer &in) override;
+	void dump(std::ostream &os, int depth) const override;
+	void scan(Inliner::Info &info) const override;
+	Expr *clone(const Inliner::Renames &names) const override;
+	void inline_calls(Inliner &in) override;
+	void emit(Emitter &em, const std::string &dest) const override;
+	Code compile() override;
+	void save(Writer &out) const override;
+	bool record(Trace &tr, Context &ctxt) const override;
+	void bind(Binder &bd) override;
+	bool passes_return(const Expr *child) const override {
+		return child != expr_.get();
+	}
 };
 
 struct Return : public Expr {
@@ -152,6 +374,15 @@ public:
 		expr_->parent_ = this;
 	}
 	const Expr *eval(Context &ctxt) const override;
+	Types infer(Infer &in) override;
+	void dump(std::ostream &os, int depth) const override;
+	void scan(Inliner::Info &info) const override;
+	Expr *clone(const Inliner::Renames &names) const override;
+	void inline_calls(Inliner &in) override;
+	void emit(Emitter &em, const std::string &dest) const override;
+	Code compile() override;
+	void save(Writer &out) const override;
+	void bind(Binder &bd) override;
 };
 
 struct ExprInt : public Expr {
@@ -163,6 +394,15 @@ public:
 		val_(i)
 	{}
 	const Expr *eval(Context &ctxt) const override;
+	Types infer(Infer &in) override;
+	void dump(std::ostream &os, int depth) const override;
+	void scan(Inliner::Info &info) const override;
+	Expr *clone(const Inliner::Renames &names) const override;
+	void inline_calls(Inliner &in) override;
+	void emit(Emitter &em, const std::string &dest) const override;
+	Code compile() override;
+	void save(Writer &out) const override;
+	bool record(Trace &tr, Context &ctxt) const override;
 };
 
 struct ExprFloat : public Expr {
@@ -174,6 +414,15 @@ public:
 		val_(d)
 	{}
 	const Expr *eval(Context &ctxt) const override;
+	Types infer(Infer &in) override;
+	void dump(std::ostream &os, int depth) const override;
+	void scan(Inliner::Info &info) const override;
+	Expr *clone(const Inliner::Renames &names) const override;
+	void inline_calls(Inliner &in) override;
+	void emit(Emitter &em, const std::string &dest) const override;
+	Code compile() override;
+	void save(Writer &out) const override;
+	bool record(Trace &tr, Context &ctxt) const override;
 };
 
 struct ExprId : public Expr {
@@ -183,6 +432,15 @@ struct ExprId : public Expr {
 		name_(n)
 	{}
 	const Expr *eval(Context &ctxt) const override;
+	Types infer(Infer &in) override;
+	void dump(std::ostream &os, int depth) const override;
+	void scan(Inliner::Info &info) const override;
+	ExprId *clone(const Inliner::Renames &names) const override;
+	void inline_calls(Inliner &in) override;
+	void emit(Emitter &em, const std::string &dest) const override;
+	Code compile() override;
+	void save(Writer &out) const override;
+	bool record(Trace &tr, Context &ctxt) const override;
 };
 
 struct ExprFunc : public Expr {
@@ -191,6 +449,8 @@ private:
 	std::unique_ptr<DeclList> decls_;
 	std::unique_ptr<ExprId> id_;
 public:
+	// set for the functions of the intrinsics table
+	const Intrinsic *intrinsic_ = nullptr;
 	ExprFunc(LocT loc, INode *body, INode *decls, INode *id = nullptr) :
 		Expr(loc),
 		body_(static_cast<Scope *>(body)),
@@ -200,11 +460,51 @@ public:
 		body_->parent_ = this;
 	}
 	const Expr *eval(Context &ctxt) const override;
+	Types infer(Infer &in) override;
+	void dump(std::ostream &os, int depth) const override;
+	void scan(Inliner::Info &info) const override;
+	Expr *clone(const Inliner::Renames &names) const override;
+	void inline_calls(Inliner &in) override;
+	void emit(Emitter &em, const std::string &dest) const override;
+	Code compile() override;
+	void save(Writer &out) const override;
+	void bind(Binder &bd) override;
+	Types call(Infer &in, const std::vector<Types> &args);
+	std::size_t arity() const {
+		return decls_->size();
+	}
+	bool inlinable(Inliner &in, std::size_t nargs) const;
+	const std::string &name() const {
+		return id_->name_;
+	}
+	bool named(const std::string &name) const {
+		return id_ && id_->name_ == name;
+	}
+	Func func() const {
+		return Func{body_.get(), decls_.get()};
+	}
+	void define(VarsT &globals) const {
+		globals[id_->name_] = Value{loc_, func()};
+	}
+	Expr *expand(Inliner &in, std::vector<std::unique_ptr<Expr>> &args, LocT loc) const;
 };
 
+// the intrinsic a function value is of, null for the other functions
+inline const Intrinsic *intrinsic(const Func &func) {
+	return static_cast<const ExprFunc *>(func.body_->parent_)->intrinsic_;
+}
+
 struct ExprQmark : public Expr {
 	ExprQmark(LocT loc) : Expr(loc) {}
 	const Expr *eval(Context &ctxt) const override;
+	Types infer(Infer &in) override;
+	void dump(std::ostream &os, int depth) const override;
+	void scan(Inliner::Info &info) const override;
+	Expr *clone(const Inliner::Renames &names) const override;
+	void inline_calls(Inliner &in) override;
+	void emit(Emitter &em, const std::string &dest) const override;
+	Code compile() override;
+	void save(Writer &out) const override;
 };
 
 struct ExprAssign : public Expr {
@@ -220,13 +520,25 @@ public:
 		id_->parent_ = expr_->parent_ = this;
 	}
 	const Expr *eval(Context &ctxt) const override;
+	Types infer(Infer &in) override;
+	void dump(std::ostream &os, int depth) const override;
+	void scan(Inliner::Info &info) const override;
+	Expr *clone(const Inliner::Renames &names) const override;
+	void inline_calls(Inliner &in) override;
+	void emit(Emitter &em, const std::string &dest) const override;
+	Code compile() override;
+	void save(Writer &out) const override;
+	bool record(Trace &tr, Context &ctxt) const override;
+	void bind(Binder &bd) override;
 };
 
 struct ExprApply : public Expr {
 private:
-	LocT loc_;
 	std::unique_ptr<ExprId> id_;
 	std::unique_ptr<ExprList> ops_;
+	// the function every call reaches, null when it is looked up by name
+	const ExprFunc *target_ = nullptr;
+	const Expr *start(Context &ctxt, const Func &func) const;
 public:
 	ExprApply(LocT loc, INode *i, INode *o) :
 		Expr(loc),
@@ -238,6 +550,128 @@ public:
 			ops_->parent_ = this;
 	}
 	const Expr *eval(Context &ctxt) const override;
+	Types infer(Infer &in) override;
+	void dump(std::ostream &os, int depth) const override;
+	void scan(Inliner::Info &info) const override;
+	Expr *clone(const Inliner::Renames &names) const override;
+	void inline_calls(Inliner &in) override;
+	void emit(Emitter &em, const std::string &dest) const override;
+	Code compile() override;
+	void save(Writer &out) const override;
+	void bind(Binder &bd) override;
+	Expr *expand(Inliner &in) override;
+	bool record(Trace &tr, Context &ctxt) const override;
+	// runs the function with the parameters in the innermost scope
+	static Value call(Context &ctxt, const Func &func);
+	bool resolve(const Binder &bd);
+};
+
+struct Import : public Expr {
+private:
+	std::string name_;
+	Module *module_;
+public:
+	Import(LocT loc, std::string name, Module *module) :
+		Expr(loc),
+		name_(name),
+		module_(module)
+	{}
+	const Expr *eval(Context &ctxt) const override;
+	Types infer(Infer &in) override;
+	void dump(std::ostream &os, int depth) const override;
+	void scan(Inliner::Info &info) const override;
+	Expr *clone(const Inliner::Renames &names) const override;
+	void inline_calls(Inliner &in) override;
+	void emit(Emitter &em, const std::string &dest) const override;
+	Code compile() override;
+	void save(Writer &out) const override;
+	void bind(Binder &bd) override;
+};
+
+// Body of a function of the host program: calls it with the parameters
+struct ExprNative : public Expr {
+private:
+	const Native *native_;
+	std::vector<std::string> params_;
+public:
+	ExprNative(LocT loc, const Native *native, std::vector<std::string> params) :
+		Expr(loc),
+		native_(native),
+		params_(std::move(params))
+	{}
+	const Expr *eval(Context &ctxt) const override;
+	Types infer(Infer &in) override;
+	void dump(std::ostream &os, int depth) const override;
+	void scan(Inliner::Info &info) const override;
+	Expr *clone(const Inliner::Renames &names) const override;
+	void inline_calls(Inliner &in) override;
+	void emit(Emitter &em, const std::string &dest) const override;
+	Code compile() override;
+	void save(Writer &out) const override;
+	Value call(Context &ctxt) const;
+};
+
+// spawn f(args): runs the call in a new coroutine, gives the task id
+struct Spawn : public Expr {
+private:
+	std::unique_ptr<ExprId> id_;
+	std::unique_ptr<ExprList> ops_;
+public:
+	Spawn(LocT loc, INode *i, INode *o) :
+		Expr(loc),
+		id_(static_cast<ExprId *>(i)),
+		ops_(static_cast<ExprList *>(o))
+	{
+		id_->parent_ = this;
+		if (ops_)
+			ops_->parent_ = this;
+	}
+	const Expr *eval(Context &ctxt) const override;
+	Types infer(Infer &in) override;
+	void dump(std::ostream &os, int depth) const override;
+	void scan(Inliner::Info &info) const override;
+	Expr *clone(const Inliner::Renames &names) const override;
+	void inline_calls(Inliner &in) override;
+	void emit(Emitter &em, const std::string &dest) const override;
+	Code compile() override;
+	void save(Writer &out) const override;
+	void bind(Binder &bd) override;
+};
+
+struct Yield : public Expr {
+	Yield(LocT loc) : Expr(loc) {}
+	const Expr *eval(Context &ctxt) const override;
+	Types infer(Infer &in) override;
+	void dump(std::ostream &os, int depth) const override;
+	void scan(Inliner::Info &info) const override;
+	Expr *clone(const Inliner::Renames &names) const override;
+	void inline_calls(Inliner &in) override;
+	void emit(Emitter &em, const std::string &dest) const override;
+	Code compile() override;
+	void save(Writer &out) const override;
+};
+
+// join task: waits for the task to finish, gives its result
+struct Join : public Expr {
+private:
+	std::unique_ptr<Expr> expr_;
+public:
+	Join(LocT loc, INode *expr) :
+		Expr(loc),
+		expr_(static_cast<Expr *>(expr))
+	{
+		expr_->parent_ = this;
+	}
+	const Expr *eval(Context &ctxt) const override;
+	Types infer(Infer &in) override;
+	void dump(std::ostream &os, int depth) const override;
+	void scan(Inliner::Info &info) const override;
+	Expr *clone(const Inliner::Renames &names) const override;
+	void inline_calls(Inliner &in) override;
+	void emit(Emitter &em, const std::string &dest) const override;
+	Code compile() override;
+	void save(Writer &out) const override;
+	void bind(Binder &bd) override;
 };
 
 template <typename T>
@@ -254,13 +688,15 @@ public:
 	{
 		lhs_->parent_ = rhs_->parent_ = this;
 	}
-	const Expr *eval(Context &ctxt) const {
+	const Expr *eval(Context &ctxt) const override {
 		if (ctxt.prev == parent_)
 			return lhs_.get();
 		if (ctxt.prev == lhs_.get())
 			return rhs_.get();
 		auto r = std::move(ctxt.res.back());
 		ctxt.res.pop_back();
+		if (T::typed(ctxt.res.back(), r, lhs_->type_, rhs_->type_))
+			return parent_;
 		auto&& l = std::move(ctxt.res.back());
 		auto&& res = op_(std::move(l), std::move(r));
 		if (res)
@@ -269,6 +705,110 @@ public:
 			throw Values::NoConversionExcept{loc_};
 		return parent_;
 	}
+	Types infer(Infer &in) override {
+		auto l = lhs_->analyze(in);
+		auto r = rhs_->analyze(in);
+		auto res = numeric(l, r, T::int_only);
+		if (res.bits == Types::None)
+			in.state.live = false;
+		return res;
+	}
+	void dump(std::ostream &os, int depth) const override {
+		dump_head(os, depth, T::name);
+		lhs_->dump(os, depth + 1);
+		rhs_->dump(os, depth + 1);
+	}
+	void scan(Inliner::Info &info) const override {
+		if (!info.enter())
+			return;
+		lhs_->scan(info);
+		rhs_->scan(info);
+	}
+	Expr *clone(const Inliner::Renames &names) const override {
+		return new ExprBinOp{loc_, lhs_->clone(names), rhs_->clone(names)};
+	}
+	void inline_calls(Inliner &in) override {
+		in.visit(lhs_);
+		in.visit(rhs_);
+	}
+	void bind(Binder &bd) override {
+		lhs_->bind(bd);
+		rhs_->bind(bd);
+	}
+	template <typename L, typename R>
+	bool record(Trace &tr, Context &ctxt) const {
+		tr.add(ctxt, this, [](Context &ctxt, Value **slots) {
+			auto r = std::move(ctxt.res.back());
+			ctxt.res.pop_back();
+			T::template typed<L, R>(ctxt.res.back(), r);
+			return true;
+		});
+		return true;
+	}
+	bool record(Trace &tr, Context &ctxt) const override {
+		if (ctxt.prev != rhs_.get())
+			return true;
+		auto lt = Trace::type(ctxt.res.end()[-2]);
+		auto rt = Trace::type(ctxt.res.back());
+		if (lt == Types::Int && rt == Types::Int)
+			return record<int, int>(tr, ctxt);
+		if constexpr (!T::int_only) {
+			if (lt == Types::Int && rt == Types::Double)
+				return record<int, double>(tr, ctxt);
+			if (lt == Types::Double && rt == Types::Int)
+				return record<double, int>(tr, ctxt);
+			if (lt == Types::Double && rt == Types::Double)
+				return record<double, double>(tr, ctxt);
+		}
+		return false;
+	}
+	void emit(Emitter &em, const std::string &dest) const override {
+		em.binop(T::func, T::int_only, lhs_.get(), rhs_.get(), loc_, dest);
+	}
+	template <typename L, typename R>
+	Code compile(Code lhs, Code rhs) const {
+		return [lhs, rhs](Context &ctxt) {
+			auto l = lhs(ctxt);
+			auto r = rhs(ctxt);
+			T::template typed<L, R>(l, r);
+			return l;
+		};
+	}
+	void save(Writer &out) const override {
+		out.put(Tag::BinOp);
+		out.put(std::string{T::name});
+		out.put(loc_);
+		lhs_->save(out);
+		rhs_->save(out);
+	}
+	Code compile() override {
+		auto lhs = lhs_->compile();
+		auto rhs = rhs_->compile();
+		auto lt = lhs_->type_.bits;
+		auto rt = rhs_->type_.bits;
+		if (lt == Types::Int && rt == Types::Int)
+			return compile<int, int>(lhs, rhs);
+		if constexpr (!T::int_only) {
+			if (lt == Types::Int && rt == Types::Double)
+				return compile<int, double>(lhs, rhs);
+			if (lt == Types::Double && rt == Types::Int)
+				return compile<double, int>(lhs, rhs);
+			if (lt == Types::Double && rt == Types::Double)
+				return compile<double, double>(lhs, rhs);
+		}
+		return [this, lhs, rhs](Context &ctxt) {
+			auto l = lhs(ctxt);
+			auto r = rhs(ctxt);
+			// numbers inference could not tell apart, such as arguments of a host
+			if (T::typed(l, r, Trace::type(l), Trace::type(r)))
+				return l;
+			ctxt.fault = this;
+			auto &&res = op_(std::move(l), std::move(r));
+			if (!res)
+				throw Values::NoConversionExcept{loc_};
+			return std::move(*res);
+		};
+	}
 };
 
 template <typename T>
@@ -286,6 +826,8 @@ public:
 	const Expr *eval(Context &ctxt) const override {
 		if (ctxt.prev == parent_)
 			return rhs_.get();
+		if (T::typed(ctxt.res.back(), rhs_->type_))
+			return parent_;
 		auto&& res = op_(std::move(ctxt.res.back()));
 		if (res)
 			ctxt.res.back() = std::move(*res);
@@ -293,103 +835,555 @@ public:
 			throw Values::NoConversionExcept{loc_};
 		return parent_;
 	}
+	Types infer(Infer &in) override {
+		auto res = numeric(rhs_->analyze(in), T::int_only);
+		if (res.bits == Types::None)
+			in.state.live = false;
+		return res;
+	}
+	void dump(std::ostream &os, int depth) const override {
+		dump_head(os, depth, T::name);
+		rhs_->dump(os, depth + 1);
+	}
+	void scan(Inliner::Info &info) const override {
+		if (info.enter())
+			rhs_->scan(info);
+	}
+	Expr *clone(const Inliner::Renames &names) const override {
+		return new ExprUnOp{loc_, rhs_->clone(names)};
+	}
+	void inline_calls(Inliner &in) override {
+		in.visit(rhs_);
+	}
+	void bind(Binder &bd) override {
+		rhs_->bind(bd);
+	}
+	template <typename V>
+	bool record(Trace &tr, Context &ctxt) const {
+		tr.add(ctxt, this, [](Context &ctxt, Value **slots) {
+			T::template typed<V>(ctxt.res.back());
+			return true;
+		});
+		return true;
+	}
+	bool record(Trace &tr, Context &ctxt) const override {
+		if (ctxt.prev != rhs_.get())
+			return true;
+		auto t = Trace::type(ctxt.res.back());
+		if (t == Types::Int)
+			return record<int>(tr, ctxt);
+		if constexpr (!T::int_only)
+			if (t == Types::Double)
+				return record<double>(tr, ctxt);
+		return false;
+	}
+	void emit(Emitter &em, const std::string &dest) const override {
+		em.unop(T::func, T::int_only, rhs_.get(), loc_, dest);
+	}
+	template <typename V>
+	Code compile(Code rhs) const {
+		return [rhs](Context &ctxt) {
+			auto val = rhs(ctxt);
+			T::template typed<V>(val);
+			return val;
+		};
+	}
+	void save(Writer &out) const override {
+		out.put(Tag::UnOp);
+		out.put(std::string{T::name});
+		out.put(loc_);
+		rhs_->save(out);
+	}
+	Code compile() override {
+		auto rhs = rhs_->compile();
+		if (rhs_->type_.bits == Types::Int)
+			return compile<int>(rhs);
+		if constexpr (!T::int_only)
+			if (rhs_->type_.bits == Types::Double)
+				return compile<double>(rhs);
+		return [this, rhs](Context &ctxt) {
+			auto val = rhs(ctxt);
+			if (T::typed(val, Trace::type(val)))
+				return val;
+			ctxt.fault = this;
+			auto &&res = op_(std::move(val));
+			if (!res)
+				throw Values::NoConversionExcept{loc_};
+			return std::move(*res);
+		};
+	}
 };
 
-struct BinOpMul {
-	auto operator() (Value lhs, Value rhs) const {
-		return apply<std::multiplies>(lhs, rhs);
-	}
+namespace detail {
+template <typename L, typename R, typename... Ts>
+struct Pick {
+	using type = void;
 };
-struct BinOpDiv {
-	auto operator() (Value lhs, Value rhs) const {
-		return apply<std::divides>(lhs, rhs);
-	}
+
+template <typename L, typename R, typename T, typename... Ts>
+struct Pick<L, R, T, Ts...> {
+	using type = std::conditional_t<std::is_same_v<T, L> || std::is_same_v<T, R>,
+		T, typename Pick<L, R, Ts...>::type>;
 };
-struct BinOpMod {
+}
+
+// Operators fall back to apply() unless the operand types are proven by
+// inference, then they work on the stored values directly
+template <template <typename> typename F, typename... Ts>
+struct BinOp {
+	static constexpr bool int_only = !(std::is_same_v<Ts, double> || ...);
 	auto operator() (Value lhs, Value rhs) const {
-		return apply<std::modulus, int>(lhs, rhs);
+		return apply<F, Ts...>(lhs, rhs);
 	}
-};
-struct BinOpPlus {
-	auto operator() (Value lhs, Value rhs) const {
-		return apply<std::plus>(lhs, rhs);
+	template <typename L, typename R>
+	static bool typed(Value &lhs, Value &rhs) {
+		using T = typename detail::Pick<L, R, Ts...>::type;
+		if constexpr (std::is_void_v<T>)
+			return false;
+		else {
+			auto res = F<T>{}(static_cast<T>(lhs.get<L>()), static_cast<T>(rhs.get<R>()));
+			if constexpr (std::is_same_v<T, L>) {
+				lhs.get<T>() = res;
+			} else {
+				rhs.get<T>() = res;
+				lhs = std::move(rhs);
+			}
+			return true;
+		}
 	}
-};
-struct BinOpMinus {
-	auto operator() (Value lhs, Value rhs) const {
-		return apply<std::minus>(lhs, rhs);
+	static bool typed(Value &lhs, Value &rhs, const Types &lt, const Types &rt) {
+		if (lt.bits == Types::Int) {
+			if (rt.bits == Types::Int)
+				return typed<int, int>(lhs, rhs);
+			if (rt.bits == Types::Double)
+				return typed<int, double>(lhs, rhs);
+		} else if (lt.bits == Types::Double) {
+			if (rt.bits == Types::Int)
+				return typed<double, int>(lhs, rhs);
+			if (rt.bits == Types::Double)
+				return typed<double, double>(lhs, rhs);
+		}
+		return false;
 	}
 };
-struct BinOpLess {
-	auto operator() (Value lhs, Value rhs) const {
-		return apply<std::less>(lhs, rhs);
+
+template <template <typename> typename F, typename... Ts>
+struct UnOp {
+	static constexpr bool int_only = !(std::is_same_v<Ts, double> || ...);
+	auto operator() (Value val) const {
+		return apply<F, Ts...>(val);
 	}
-};
-struct BinOpGrtr {
-	auto operator() (Value lhs, Value rhs) const {
-		return apply<std::greater>(lhs, rhs);
+	template <typename T>
+	static bool typed(Value &val) {
+		if constexpr (std::is_void_v<typename detail::Pick<T, T, Ts...>::type>)
+			return false;
+		else {
+			val.get<T>() = F<T>{}(val.get<T>());
+			return true;
+		}
 	}
-};
-struct BinOpLessOrEq {
-	auto operator() (Value lhs, Value rhs) const {
-		return apply<std::less_equal>(lhs, rhs);
+	static bool typed(Value &val, const Types &t) {
+		if (t.bits == Types::Int)
+			return typed<int>(val);
+		if (t.bits == Types::Double)
+			return typed<double>(val);
+		return false;
 	}
 };
-struct BinOpGrtrOrEq {
-	auto operator() (Value lhs, Value rhs) const {
-		return apply<std::greater_equal>(lhs, rhs);
-	}
+
+struct BinOpMul : BinOp<std::multiplies, double, int> {
+	static constexpr auto name = "*";
+	static constexpr auto func = "std::multiplies";
 };
-struct BinOpEqual {
-	auto operator() (Value lhs, Value rhs) const {
-		return apply<std::equal_to>(lhs, rhs);
-	}
+struct BinOpDiv : BinOp<std::divides, double, int> {
+	static constexpr auto name = "/";
+	static constexpr auto func = "std::divides";
 };
-struct BinOpNotEqual {
-	auto operator() (Value lhs, Value rhs) const {
-		return apply<std::not_equal_to>(lhs, rhs);
-	}
+struct BinOpMod : BinOp<std::modulus, int> {
+	static constexpr auto name = "%";
+	static constexpr auto func = "std::modulus";
 };
-struct BinOpAnd {
-	auto operator() (Value lhs, Value rhs) const {
-		return apply<std::logical_and>(lhs, rhs);
+struct BinOpPlus : BinOp<std::plus, double, int> {
+	static constexpr auto name = "+";
+	static constexpr auto func = "std::plus";
+};
+struct BinOpMinus : BinOp<std::minus, double, int> {
+	static constexpr auto name = "-";
+	static constexpr auto func = "std::minus";
+};
+struct BinOpLess : BinOp<std::less, double, int> {
+	static constexpr auto name = "<";
+	static constexpr auto func = "std::less";
+};
+struct BinOpGrtr : BinOp<std::greater, double, int> {
+	static constexpr auto name = ">";
+	static constexpr auto func = "std::greater";
+};
+struct BinOpLessOrEq : BinOp<std::less_equal, double, int> {
+	static constexpr auto name = "<=";
+	static constexpr auto func = "std::less_equal";
+};
+struct BinOpGrtrOrEq : BinOp<std::greater_equal, double, int> {
+	static constexpr auto name = ">=";
+	static constexpr auto func = "std::greater_equal";
+};
+struct BinOpEqual : BinOp<std::equal_to, double, int> {
+	static constexpr auto name = "==";
+	static constexpr auto func = "std::equal_to";
+};
+struct BinOpNotEqual : BinOp<std::not_equal_to, double, int> {
+	static constexpr auto name = "!=";
+	static constexpr auto func = "std::not_equal_to";
+};
+struct BinOpAnd : BinOp<std::logical_and, double, int> {
+	static constexpr auto name = "&&";
+	static constexpr auto func = "std::logical_and";
+};
+struct BinOpOr : BinOp<std::logical_or, double, int> {
+	static constexpr auto name = "||";
+	static constexpr auto func = "std::logical_or";
+};
+
+template <typename T>
+struct Plus {
+	auto operator() (T a) { return +a; }
+};
+template <typename T>
+struct Print {
+	auto operator() (T a) {
+		std::cout << a << std::endl;
+		return a;
 	}
 };
-struct BinOpOr {
-	auto operator() (Value lhs, Value rhs) const {
-		return apply<std::logical_or>(lhs, rhs);
+
+struct UnOpPlus : UnOp<Plus, double, int> {
+	static constexpr auto name = "+";
+	static constexpr auto func = "rt::Plus";
+};
+struct UnOpMinus : UnOp<std::negate, double, int> {
+	static constexpr auto name = "-";
+	static constexpr auto func = "std::negate";
+};
+struct UnOpNot : UnOp<std::logical_not, double, int> {
+	static constexpr auto name = "!";
+	static constexpr auto func = "std::logical_not";
+};
+struct UnOpPrint : UnOp<Print, double, int> {
+	static constexpr auto name = "print";
+	static constexpr auto func = "rt::Print";
+};
+
+// Operators of the intrinsics table, integers have their own absolute value,
+// square root and power, which truncates a negative exponent like division.
+// The absolute value of an int is taken in unsigned, where INT_MIN has one,
+// so abs(INT_MIN) wraps around to INT_MIN and gcd(INT_MIN, 0) too
+inline unsigned magnitude(int a) {
+	return a < 0 ? 0u - static_cast<unsigned>(a) : a;
+}
+template <typename T>
+struct Abs {
+	T operator() (T a) { return std::abs(a); }
+};
+template <>
+struct Abs<int> {
+	int operator() (int a) { return magnitude(a); }
+};
+template <typename T>
+struct Sqrt {
+	T operator() (T a) { return std::sqrt(a); }
+};
+template <>
+struct Sqrt<int> {
+	int operator() (int a) { return a > 0 ? static_cast<int>(std::sqrt(static_cast<double>(a))) : 0; }
+};
+template <typename T>
+struct Min {
+	T operator() (T a, T b) { return b < a ? b : a; }
+};
+template <typename T>
+struct Max {
+	T operator() (T a, T b) { return a < b ? b : a; }
+};
+template <typename T>
+struct Gcd {
+	T operator() (T a, T b) { return std::gcd(magnitude(a), magnitude(b)); }
+};
+template <typename T>
+struct Pow {
+	T operator() (T a, T b) { return std::pow(a, b); }
+};
+template <>
+struct Pow<int> {
+	int operator() (int a, int b) {
+		if (b < 0)
+			return a == 1 ? 1 : a == -1 ? (b % 2 ? -1 : 1) : 0;
+		unsigned res = 1;
+		for (unsigned base = a; b; b >>= 1, base *= base)
+			if (b & 1)
+				res *= base;
+		return res;
 	}
 };
+// shifts take the count modulo the width of int
+template <typename T>
+struct Shl {
+	T operator() (T a, T b) { return static_cast<unsigned>(a) << (b & 31); }
+};
+template <typename T>
+struct Shr {
+	T operator() (T a, T b) { return a >> (b & 31); }
+};
 
-struct UnOpPlus {
-	template <typename T>
-	struct Plus {
-		auto operator() (T a) { return +a; }
+struct UnOpAbs : UnOp<Abs, double, int> {
+	static constexpr auto name = "abs";
+	static constexpr auto func = "rt::Abs";
+};
+struct UnOpSqrt : UnOp<Sqrt, double, int> {
+	static constexpr auto name = "sqrt";
+	static constexpr auto func = "rt::Sqrt";
+};
+struct UnOpBitNot : UnOp<std::bit_not, int> {
+	static constexpr auto name = "bit_not";
+	static constexpr auto func = "std::bit_not";
+};
+struct BinOpMin : BinOp<Min, double, int> {
+	static constexpr auto name = "min";
+	static constexpr auto func = "rt::Min";
+};
+struct BinOpMax : BinOp<Max, double, int> {
+	static constexpr auto name = "max";
+	static constexpr auto func = "rt::Max";
+};
+struct BinOpGcd : BinOp<Gcd, int> {
+	static constexpr auto name = "gcd";
+	static constexpr auto func = "rt::Gcd";
+};
+struct BinOpPow : BinOp<Pow, double, int> {
+	static constexpr auto name = "pow";
+	static constexpr auto func = "rt::Pow";
+};
+struct BinOpBitAnd : BinOp<std::bit_and, int> {
+	static constexpr auto name = "bit_and";
+	static constexpr auto func = "std::bit_and";
+};
+struct BinOpBitOr : BinOp<std::bit_or, int> {
+	static constexpr auto name = "bit_or";
+	static constexpr auto func = "std::bit_or";
+};
+struct BinOpBitXor : BinOp<std::bit_xor, int> {
+	static constexpr auto name = "bit_xor";
+	static constexpr auto func = "std::bit_xor";
+};
+struct BinOpShl : BinOp<Shl, int> {
+	static constexpr auto name = "shl";
+	static constexpr auto func = "rt::Shl";
+};
+struct BinOpShr : BinOp<Shr, int> {
+	static constexpr auto name = "shr";
+	static constexpr auto func = "rt::Shr";
+};
+
+// print writes through the context, it may belong to a host program
+template <>
+inline const Expr *ExprUnOp<UnOpPrint>::eval(Context &ctxt) const {
+	if (ctxt.prev == parent_)
+		return rhs_.get();
+	if (!ctxt.print(ctxt.res.back()))
+		throw Values::NoConversionExcept{loc_};
+	return parent_;
+}
+
+template <>
+inline bool ExprUnOp<UnOpPrint>::record(Trace &tr, Context &ctxt) const {
+	if (ctxt.prev != rhs_.get())
+		return true;
+	tr.add(ctxt, this, [](Context &ctxt, Value **slots) {
+		return ctxt.print(ctxt.res.back());
+	});
+	return true;
+}
+
+template <>
+inline Code ExprUnOp<UnOpPrint>::compile() {
+	return [this, rhs = rhs_->compile()](Context &ctxt) {
+		auto val = rhs(ctxt);
+		ctxt.fault = this;
+		if (!ctxt.print(val))
+			throw Values::NoConversionExcept{loc_};
+		return val;
 	};
-	auto operator() (Value val) const {
-		return apply<Plus>(val);
-	}
+}
+
+// A function of the intrinsics table. Calls bound to it apply its operator
+// to the arguments where they are instead of making them parameters of a
+// scope. The arguments come in the order of the parameters, on the stack of
+// results the first one is on top.
+struct Intrinsic {
+	virtual ~Intrinsic() = default;
+	virtual const char *name() const = 0;
+	virtual std::size_t arity() const = 0;
+	// the operator applied to the parameters, for the calls that are not bound
+	virtual Expr *body(LocT loc) const = 0;
+	virtual Types infer(const std::vector<Types> &args) const = 0;
+	virtual void eval(Context &ctxt, const Expr *call) const = 0;
+	virtual bool record(Trace &tr, Context &ctxt, const Expr *call) const = 0;
+	// the arguments still run starting from the last one
+	virtual Code compile(const Expr *call, const std::vector<Code> &args,
+		const std::vector<Types> &types) const = 0;
 };
-struct UnOpMinus {
-	auto operator() (Value val) const {
-		return apply<std::negate>(val);
+
+template <typename T>
+struct IntrinsicBinOp : Intrinsic {
+	const char *name() const override {
+		return T::name;
 	}
-};
-struct UnOpNot {
-	auto operator() (Value val) const {
-		return apply<std::logical_not>(val);
+	std::size_t arity() const override {
+		return 2;
 	}
-};
-struct UnOpPrint {
-	template <typename T>
-	struct Print {
-		auto operator() (T a) {
-			std::cout << a << std::endl;
-			return a;
+	Expr *body(LocT loc) const override {
+		return new ExprBinOp<T>{loc, new ExprId{loc, "0"}, new ExprId{loc, "1"}};
+	}
+	Types infer(const std::vector<Types> &args) const override {
+		return numeric(args[0], args[1], T::int_only);
+	}
+	static Value apply(const Expr *call, Value lhs, Value rhs) {
+		if (T::typed(lhs, rhs, Trace::type(lhs), Trace::type(rhs)))
+			return lhs;
+		auto &&res = T{}(std::move(lhs), std::move(rhs));
+		if (!res)
+			throw Values::NoConversionExcept{call->loc_};
+		return std::move(*res);
+	}
+	void eval(Context &ctxt, const Expr *call) const override {
+		auto lhs = std::move(ctxt.res.back());
+		ctxt.res.pop_back();
+		ctxt.res.back() = apply(call, std::move(lhs), std::move(ctxt.res.back()));
+	}
+	template <typename L, typename R>
+	static bool record(Trace &tr, Context &ctxt, const Expr *call) {
+		tr.add(ctxt, call, [](Context &ctxt, Value **slots) {
+			auto lhs = std::move(ctxt.res.back());
+			ctxt.res.pop_back();
+			T::template typed<L, R>(lhs, ctxt.res.back());
+			ctxt.res.back() = std::move(lhs);
+			return true;
+		});
+		return true;
+	}
+	bool record(Trace &tr, Context &ctxt, const Expr *call) const override {
+		auto lt = Trace::type(ctxt.res.back());
+		auto rt = Trace::type(ctxt.res.end()[-2]);
+		if (lt == Types::Int && rt == Types::Int)
+			return record<int, int>(tr, ctxt, call);
+		if constexpr (!T::int_only) {
+			if (lt == Types::Int && rt == Types::Double)
+				return record<int, double>(tr, ctxt, call);
+			if (lt == Types::Double && rt == Types::Int)
+				return record<double, int>(tr, ctxt, call);
+			if (lt == Types::Double && rt == Types::Double)
+				return record<double, double>(tr, ctxt, call);
 		}
-	};
-	auto operator() (Value val) const {
-		return apply<Print>(val);
+		return false;
+	}
+	template <typename L, typename R>
+	static Code compile(Code lhs, Code rhs) {
+		return [lhs, rhs](Context &ctxt) {
+			auto r = rhs(ctxt);
+			auto l = lhs(ctxt);
+			T::template typed<L, R>(l, r);
+			return l;
+		};
+	}
+	Code compile(const Expr *call, const std::vector<Code> &args,
+		const std::vector<Types> &types) const override
+	{
+		auto &&lhs = args[0];
+		auto &&rhs = args[1];
+		auto lt = types[0].bits;
+		auto rt = types[1].bits;
+		if (lt == Types::Int && rt == Types::Int)
+			return compile<int, int>(lhs, rhs);
+		if constexpr (!T::int_only) {
+			if (lt == Types::Int && rt == Types::Double)
+				return compile<int, double>(lhs, rhs);
+			if (lt == Types::Double && rt == Types::Int)
+				return compile<double, int>(lhs, rhs);
+			if (lt == Types::Double && rt == Types::Double)
+				return compile<double, double>(lhs, rhs);
+		}
+		return [call, lhs, rhs](Context &ctxt) {
+			auto r = rhs(ctxt);
+			auto l = lhs(ctxt);
+			ctxt.fault = call;
+			return apply(call, std::move(l), std::move(r));
+		};
+	}
+};
+
+template <typename T>
+struct IntrinsicUnOp : Intrinsic {
+	const char *name() const override {
+		return T::name;
+	}
+	std::size_t arity() const override {
+		return 1;
+	}
+	Expr *body(LocT loc) const override {
+		return new ExprUnOp<T>{loc, new ExprId{loc, "0"}};
+	}
+	Types infer(const std::vector<Types> &args) const override {
+		return numeric(args[0], T::int_only);
+	}
+	static Value apply(const Expr *call, Value val) {
+		if (T::typed(val, Trace::type(val)))
+			return val;
+		auto &&res = T{}(std::move(val));
+		if (!res)
+			throw Values::NoConversionExcept{call->loc_};
+		return std::move(*res);
+	}
+	void eval(Context &ctxt, const Expr *call) const override {
+		ctxt.res.back() = apply(call, std::move(ctxt.res.back()));
+	}
+	template <typename V>
+	static bool record(Trace &tr, Context &ctxt, const Expr *call) {
+		tr.add(ctxt, call, [](Context &ctxt, Value **slots) {
+			T::template typed<V>(ctxt.res.back());
+			return true;
+		});
+		return true;
+	}
+	bool record(Trace &tr, Context &ctxt, const Expr *call) const override {
+		auto t = Trace::type(ctxt.res.back());
+		if (t == Types::Int)
+			return record<int>(tr, ctxt, call);
+		if constexpr (!T::int_only)
+			if (t == Types::Double)
+				return record<double>(tr, ctxt, call);
+		return false;
+	}
+	template <typename V>
+	static Code compile(Code arg) {
+		return [arg](Context &ctxt) {
+			auto val = arg(ctxt);
+			T::template typed<V>(val);
+			return val;
+		};
+	}
+	Code compile(const Expr *call, const std::vector<Code> &args,
+		const std::vector<Types> &types) const override
+	{
+		auto &&arg = args[0];
+		if (types[0].bits == Types::Int)
+			return compile<int>(arg);
+		if constexpr (!T::int_only)
+			if (types[0].bits == Types::Double)
+				return compile<double>(arg);
+		return [call, arg](Context &ctxt) {
+			auto val = arg(ctxt);
+			ctxt.fault = call;
+			return apply(call, std::move(val));
+		};
 	}
 };
 }
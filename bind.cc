@@ -0,0 +1,101 @@
+#include "ast.hh"
+#include "exec.hh"
+
+namespace AST {
+
+std::size_t bind_calls(INode *root) {
+	Binder bd;
+	static_cast<Expr *>(root)->bind(bd);
+	std::size_t count = 0;
+	for (auto &&call : bd.calls)
+		count += call->resolve(bd);
+	return count;
+}
+
+void Binder::define(ExprFunc *func) {
+	auto def = defines.emplace(func->name(), func);
+	if (def.first->second != func)
+		def.first->second = nullptr;
+}
+
+void ExprList::bind(Binder &bd) {
+	for (auto list = this; list; list = list->tail_.get())
+		list->head_->bind(bd);
+}
+
+void Scope::bind(Binder &bd) {
+	if (blocks_)
+		blocks_->bind(bd);
+}
+
+void Seq::bind(Binder &bd) {
+	auto seqs = chain(this);
+	seqs.back()->fst_->bind(bd);
+	for (auto it = seqs.rbegin(), end = seqs.rend(); it != end; ++it)
+		(*it)->snd_->bind(bd);
+}
+
+void While::bind(Binder &bd) {
+	expr_->bind(bd);
+	block_->bind(bd);
+}
+
+void If::bind(Binder &bd) {
+	expr_->bind(bd);
+	true_block_->bind(bd);
+	if (false_block_)
+		false_block_->bind(bd);
+}
+
+void Return::bind(Binder &bd) {
+	expr_->bind(bd);
+}
+
+void ExprFunc::bind(Binder &bd) {
+	if (id_)
+		bd.define(this);
+	bd.assigned.insert(decls_->cbegin(), decls_->cend());
+	body_->bind(bd);
+}
+
+void ExprAssign::bind(Binder &bd) {
+	// f = func(...) : f { ... } writes the same function twice
+	auto func = dynamic_cast<ExprFunc *>(expr_.get());
+	if (!func || !func->named(id_->name_))
+		bd.assigned.insert(id_->name_);
+	expr_->bind(bd);
+}
+
+void ExprApply::bind(Binder &bd) {
+	bd.calls.push_back(this);
+	if (ops_)
+		ops_->bind(bd);
+}
+
+bool ExprApply::resolve(const Binder &bd) {
+	auto def = bd.defines.find(id_->name_);
+	if (def == bd.defines.end() || !def->second || bd.assigned.count(id_->name_))
+		return false;
+	// the function has to be defined by the time the call is reached
+	auto func = def->second;
+	if (id_->type_ != Types{func} || func->arity() != (ops_ ? ops_->size() : 0))
+		return false;
+	target_ = func;
+	return true;
+}
+
+void Import::bind(Binder &bd) {
+	// the others are never called, type inference has not looked them up
+	for (auto &&func : module_->loaded())
+		func->bind(bd);
+}
+
+void Spawn::bind(Binder &bd) {
+	if (ops_)
+		ops_->bind(bd);
+}
+
+void Join::bind(Binder &bd) {
+	expr_->bind(bd);
+}
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace AST {
+
+struct ExprFunc;
+struct ExprApply;
+
+// Names the whole program writes and the calls that may be bound to a
+// named function instead of looking it up on every call
+struct Binder {
+	// functions by the name they define, null when there are several
+	std::map<std::string, ExprFunc *> defines;
+	// names assigned anywhere or taken as a parameter
+	std::set<std::string> assigned;
+	std::vector<ExprApply *> calls;
+
+	void define(ExprFunc *func);
+};
+}
@@ -0,0 +1,327 @@
+#include "ast.hh"
+#include "exec.hh"
+#include <algorithm>
+#include <iterator>
+
+namespace AST {
+
+void exec(INode *root) {
+	Governor gov;
+	exec(root, gov);
+}
+
+bool exec(INode *root, Governor &gov) {
+	// closures cannot stop in the middle, time slices are walked
+	if (gov.slice)
+		return walk(root, gov);
+	auto expr = static_cast<Expr *>(root);
+	Context ctxt;
+	ctxt.call_stack.emplace_back();
+	ctxt.countdown = gov.start();
+	gov.arm(ctxt);
+	try {
+		auto code = expr->compile();
+		code(ctxt);
+	} catch (const Context::Suspends &) {
+		return walk(root, gov);
+	} catch (const Values::ValueExcept& err) {
+		std::cout << "Type error: " << err << " is used at " << ctxt.fault->loc_ << std::endl;
+	} catch (const std::logic_error& err) {
+		std::cout << "Semantic error: " << err.what() << std::endl;
+	} catch (const Context::Exceeded &err) {
+		std::cout << "Limit exceeded: " << err.what() << std::endl;
+	} catch (const std::bad_alloc& ba) {
+		std::cout << "Context is too large: " << ba.what() << std::endl;
+	}
+	return true;
+}
+
+Code Empty::compile() {
+	return [](Context &ctxt) {
+		return Value{};
+	};
+}
+
+Code Scope::compile() {
+	if (!blocks_)
+		return [](Context &ctxt) {
+			return Value{};
+		};
+	return [blocks = blocks_->compile()](Context &ctxt) {
+		ctxt.scope_stack.emplace_back();
+		Value res;
+		try {
+			res = blocks(ctxt);
+		} catch (Context::Unwind &ret) {
+			res = std::move(ret.res);
+		}
+		ctxt.returning = false;
+		ctxt.scope_stack.pop_back();
+		return res;
+	};
+}
+
+Code Seq::compile() {
+	// blocks are nested to the left, run them in a loop instead
+	auto seqs = chain(this);
+	std::vector<Code> blocks;
+	auto fst = seqs.back()->fst_.get();
+	if (!dynamic_cast<Empty *>(fst))
+		blocks.push_back(fst->compile());
+	for (auto it = seqs.rbegin(), end = seqs.rend(); it != end; ++it)
+		blocks.push_back((*it)->snd_->compile());
+	return [blocks = std::move(blocks)](Context &ctxt) {
+		auto last = std::prev(blocks.end());
+		for (auto it = blocks.begin(); it != last; ++it) {
+			auto res = (*it)(ctxt);
+			if (ctxt.returning)
+				return res;
+		}
+		return (*last)(ctxt);
+	};
+}
+
+Code While::compile() {
+	return [this, expr = expr_->compile(), block = block_->compile()](Context &ctxt) {
+		for (;;) {
+			auto cond = expr(ctxt);
+			ctxt.fault = this;
+			if (!truth(cond, expr_->type_))
+				return cond;
+			ctxt.tick();
+			auto res = block(ctxt);
+			if (ctxt.returning)
+				return res;
+		}
+	};
+}
+
+Code If::compile() {
+	auto expr = expr_->compile();
+	auto true_block = true_block_->compile();
+	Code false_block;
+	if (false_block_)
+		false_block = false_block_->compile();
+	else
+		false_block = [](Context &ctxt) {
+			return Value{};
+		};
+	return [this, expr, true_block, false_block](Context &ctxt) {
+		auto cond = expr(ctxt);
+		ctxt.fault = this;
+		if (truth(cond, expr_->type_))
+			return true_block(ctxt);
+		return false_block(ctxt);
+	};
+}
+
+Code Return::compile() {
+	// statements check the flag, other expressions are left by unwinding
+	const Expr *node = this;
+	while (!dynamic_cast<const Scope *>(node->parent_) && node->parent_->passes_return(node))
+		node = node->parent_;
+	if (dynamic_cast<const Scope *>(node->parent_))
+		return [expr = expr_->compile()](Context &ctxt) {
+			auto res = expr(ctxt);
+			ctxt.returning = true;
+			return res;
+		};
+	return [expr = expr_->compile()](Context &ctxt) -> Value {
+		throw Context::Unwind{expr(ctxt)};
+	};
+}
+
+Code ExprInt::compile() {
+	return [loc = loc_, val = val_](Context &ctxt) {
+		return Value{loc, val};
+	};
+}
+
+Code ExprFloat::compile() {
+	return [loc = loc_, val = val_](Context &ctxt) {
+		return Value{loc, val};
+	};
+}
+
+Code ExprId::compile() {
+	return [&name = name_](Context &ctxt) {
+		auto var = ctxt.lookup(name);
+		return var ? *var : Value{};
+	};
+}
+
+Code ExprList::compile() {
+	std::vector<Code> args;
+	compile_args(args);
+	return [args = std::move(args)](Context &ctxt) {
+		for (auto &&arg : args)
+			arg(ctxt);
+		return Value{};
+	};
+}
+
+void ExprList::compile_args(std::vector<Code> &args) {
+	for (auto list = this; list; list = list->tail_.get())
+		args.push_back(list->head_->compile());
+}
+
+void ExprList::arg_types(std::vector<Types> &types) const {
+	for (auto list = this; list; list = list->tail_.get())
+		types.push_back(list->head_->type_);
+}
+
+Code ExprFunc::compile() {
+	body_->code_ = body_->compile();
+	return [this](Context &ctxt) {
+		Value res{loc_, Func{body_.get(), decls_.get()}};
+		if (id_)
+			ctxt.scope_stack.front()[id_->name_] = res;
+		return res;
+	};
+}
+
+Code ExprQmark::compile() {
+	return [loc = loc_](Context &ctxt) {
+		return ctxt.read(loc);
+	};
+}
+
+Code ExprAssign::compile() {
+	return [&name = id_->name_, expr = expr_->compile()](Context &ctxt) {
+		auto res = expr(ctxt);
+		if (auto var = ctxt.find(name))
+			*var = res;
+		else
+			ctxt.scope_stack.back().emplace(name, res);
+		return res;
+	};
+}
+
+Code ExprApply::compile() {
+	std::vector<Code> args;
+	if (ops_)
+		ops_->compile_args(args);
+	if (target_ && target_->intrinsic_) {
+		std::vector<Types> types;
+		ops_->arg_types(types);
+		std::reverse(args.begin(), args.end());
+		std::reverse(types.begin(), types.end());
+		return target_->intrinsic_->compile(this, args, types);
+	}
+	if (target_)
+		return [this, args = std::move(args), func = target_->func()](Context &ctxt) {
+			auto base = ctxt.res.size();
+			for (auto &&arg : args)
+				ctxt.res.push_back(arg(ctxt));
+			ctxt.fault = this;
+			auto &&params = ctxt.scope_stack.emplace_back();
+			auto val = ctxt.res.rbegin();
+			for (auto it = func.decls_->cbegin(), end = func.decls_->cend(); it != end; ++it)
+				params.emplace(*it, std::move(*val++));
+			ctxt.res.resize(base);
+			return call(ctxt, func);
+		};
+	return [this, args = std::move(args), id = id_->compile()](Context &ctxt) {
+		auto base = ctxt.res.size();
+		for (auto &&arg : args)
+			ctxt.res.push_back(arg(ctxt));
+		auto top = id(ctxt);
+		ctxt.fault = this;
+		Func func = id_->type_.bits == Types::Func ? top.get<Func>() : static_cast<Func>(top);
+		if (args.size() != func.decls_->size())
+			throw std::logic_error("Incorrect number of arguments");
+		if (auto op = intrinsic(func)) {
+			op->eval(ctxt, this);
+			auto res = std::move(ctxt.res.back());
+			ctxt.res.resize(base);
+			return res;
+		}
+		auto &&params = ctxt.scope_stack.emplace_back();
+		// arguments are evaluated starting from the last one
+		auto val = ctxt.res.rbegin();
+		for (auto it = func.decls_->cbegin(), end = func.decls_->cend(); it != end; ++it)
+			params.emplace(*it, std::move(*val++));
+		ctxt.res.resize(base);
+		return call(ctxt, func);
+	};
+}
+
+Value ExprApply::call(Context &ctxt, const Func &func) {
+	ctxt.tick();
+	ctxt.enter(ctxt.depth + ctxt.ctxts_stack.size() + 1);
+	auto frame = ctxt.frame;
+	ctxt.frame = ctxt.scope_stack.size() - 1;
+	Value res;
+	if (ctxt.depth < Context::max_depth) {
+		++ctxt.depth;
+		res = func.body_->code_(ctxt);
+		--ctxt.depth;
+	} else {
+		// deep recursion continues on the heap allocated stacks of the walker
+		Context::ScopeStackT scopes;
+		scopes.push_back(std::move(ctxt.scope_stack.front()));
+		scopes.push_back(std::move(ctxt.scope_stack.back()));
+		std::swap(scopes, ctxt.scope_stack);
+		ctxt.call_stack.emplace_back();
+		ctxt.walk(func.body_);
+		ctxt.call_stack.pop_back();
+		res = std::move(ctxt.res.back());
+		ctxt.res.pop_back();
+		std::swap(scopes, ctxt.scope_stack);
+		ctxt.scope_stack.front() = std::move(scopes.front());
+	}
+	ctxt.scope_stack.pop_back();
+	ctxt.frame = frame;
+	return res;
+}
+
+Code Import::compile() {
+	// type inference has looked up every function the program may call
+	for (auto &&func : module_->loaded())
+		func->compile();
+	return [this](Context &ctxt) {
+		if (module_->builtin)
+			for (auto &&func : module_->loaded())
+				func->define(ctxt.builtins);
+		else
+			ctxt.open(module_);
+		return Value{};
+	};
+}
+
+Code ExprNative::compile() {
+	return [this](Context &ctxt) {
+		return call(ctxt);
+	};
+}
+
+Value ExprNative::call(Context &ctxt) const {
+	std::vector<Number> args;
+	args.reserve(params_.size());
+	ctxt.fault = this;
+	for (auto &&name : params_) {
+		auto var = ctxt.find(name);
+		if (!var)
+			throw Values::UdefValExcept{};
+		if (var->isSameType<double>())
+			args.push_back(static_cast<double>(*var));
+		else
+			args.push_back(static_cast<int>(*var));
+	}
+	return std::visit([loc = loc_](auto val) {
+		return Value{loc, val};
+	}, native_->call(args.data()));
+}
+
+Code Spawn::compile() {
+	throw Context::Suspends{};
+}
+
+Code Yield::compile() {
+	throw Context::Suspends{};
+}
+
+Code Join::compile() {
+	throw Context::Suspends{};
+}
+}
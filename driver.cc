@@ -1,12 +1,75 @@
 #include "driver.hh"
+#include <filesystem>
 #include <fstream>
+#include <string>
 
 int main(int argc, char **argv) {
+	// cin buffers the input itself, so the scheduler can see what is left
+	std::ios::sync_with_stdio(false);
+	bool dump_types = false;
+	bool walker = false;
+	std::string emit_cpp;
+	std::size_t inline_budget = 32;
+	bool bind = true;
+	AST::Governor gov;
+	int arg = 1;
+	for (; arg < argc - 1; ++arg) {
+		std::string opt{argv[arg]};
+		if (opt == "--dump-types")
+			dump_types = true;
+		else if (opt == "--walker")
+			walker = true;
+		else if (opt == "--no-inline")
+			inline_budget = 0;
+		else if (opt == "--no-trace")
+			AST::Tracer::enabled = false;
+		else if (opt == "--trace-report")
+			AST::Tracer::report = true;
+		else if (opt == "--no-bind")
+			bind = false;
+		else if (opt.rfind("--inline-budget=", 0) == 0)
+			inline_budget = std::stoul(opt.substr(opt.find('=') + 1));
+		else if (opt.rfind("--max-steps=", 0) == 0)
+			gov.steps = std::stoul(opt.substr(opt.find('=') + 1));
+		else if (opt.rfind("--max-depth=", 0) == 0)
+			gov.depth = std::stoul(opt.substr(opt.find('=') + 1));
+		else if (opt.rfind("--max-memory=", 0) == 0)
+			gov.memory = std::stoul(opt.substr(opt.find('=') + 1));
+		else if (opt.rfind("--timeout=", 0) == 0)
+			gov.time = std::chrono::milliseconds{std::stoul(opt.substr(opt.find('=') + 1))};
+		else if (opt.rfind("--slice=", 0) == 0)
+			gov.slice = std::stoul(opt.substr(opt.find('=') + 1));
+		else if (opt.rfind("--emit-cpp=", 0) == 0)
+			emit_cpp = opt.substr(opt.find('=') + 1);
+		else {
+			std::cerr << "Unknown option: " << opt << std::endl;
+			return 1;
+		}
+	}
 	std::ifstream code_file;
-	code_file.open(argv[1]);
-	yy::Driver driver{&code_file};
+	code_file.open(argv[arg]);
+	// imports are looked up next to the program first
+	auto dir = std::filesystem::path{argv[arg]}.parent_path().string();
+	yy::Driver driver{&code_file, dir.empty() ? "." : dir};
 	auto root = driver.parse();
-	if (root)
-		exec(root);
+	int status = 0;
+	if (root) {
+		AST::infer(root);
+		if (inline_budget && AST::inline_calls(root, inline_budget))
+			AST::infer(root);
+		if (bind)
+			AST::bind_calls(root);
+		if (dump_types)
+			AST::dump_types(root, std::cerr);
+		if (!emit_cpp.empty()) {
+			std::ofstream out{emit_cpp};
+			if (!AST::emit_cpp(root, out))
+				status = 1;
+		} else if (walker)
+			while (!AST::walk(root, gov));
+		else
+			while (!AST::exec(root, gov));
+	}
 	delete root;
+	return status;
 }
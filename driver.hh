@@ -2,13 +2,25 @@
 #include "inode.hh"
 #include "lexer.hh"
 #include "exec.hh"
+#include "module.hh"
 #include <iostream>
+#include <stdexcept>
+#include <string>
 
 namespace yy {
 struct Driver final {
 	Lexer lexer;
 	AST::INode *yylval;
-	Driver(std::istream *is) : lexer(is), yylval(nullptr)
+	// file name of the locations and directory imports are looked up in
+	const std::string *file;
+	std::string dir;
+	// functions of a host program, defined before the first block
+	AST::Module *host = nullptr;
+	// modules see the intrinsics of the program importing them
+	bool intrinsics = true;
+	int errors = 0;
+	Driver(std::istream *is, std::string d = ".", const std::string *f = nullptr) :
+		lexer(is), yylval(nullptr), file(f), dir(std::move(d))
 	{}
 	AST::INode *parse() {
 		yy::parser parser{*this};
@@ -16,5 +28,24 @@ struct Driver final {
 			return nullptr;
 		return yylval;
 	}
+	AST::INode *program(const yy::location &loc, AST::INode *blocks) {
+		if (host)
+			blocks = AST::make<AST::Seq>(loc, AST::make<AST::Import>(loc, host->path, host), blocks);
+		if (intrinsics) {
+			auto &&lib = AST::Module::intrinsics();
+			blocks = AST::make<AST::Seq>(loc, AST::make<AST::Import>(loc, lib.path, &lib), blocks);
+		}
+		return AST::make<AST::Scope>(loc, blocks);
+	}
+	AST::INode *import(const yy::location &loc, AST::INode *id) {
+		auto name = std::move(static_cast<AST::ExprId *>(id)->name_);
+		delete id;
+		try {
+			auto module = AST::Modules::instance().load(name, dir);
+			return AST::make<AST::Import>(loc, name, module);
+		} catch (const std::runtime_error &err) {
+			throw yy::parser::syntax_error(loc, err.what());
+		}
+	}
 };
 }
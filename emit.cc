@@ -0,0 +1,289 @@
+#include "ast.hh"
+#include "exec.hh"
+#include <iomanip>
+#include <iterator>
+
+namespace AST {
+
+extern const char *const aot_runtime;
+
+bool emit_cpp(const INode *root, std::ostream &os) {
+	Emitter em;
+	std::ostringstream body;
+	em.os = &body;
+	em.indent = 1;
+	try {
+		static_cast<const Expr *>(root)->emit(em, "res");
+	} catch (const std::logic_error &err) {
+		std::cerr << "Semantic error: " << err.what() << std::endl;
+		return false;
+	}
+
+	os << aot_runtime << "\nnamespace {\n\n";
+	for (std::size_t i = 0; i < em.funcs.size(); ++i) {
+		os << "rt::Value f" << i << "(rt::Env &env);\n";
+		if (em.params[i].empty())
+			continue;
+		os << "const int p" << i << "[] = {";
+		auto sep = "";
+		for (auto &&param : em.params[i]) {
+			os << sep << param;
+			sep = ", ";
+		}
+		os << "};\n";
+	}
+	os << "\nconst rt::Function functions[] = {\n";
+	for (std::size_t i = 0; i < em.funcs.size(); ++i) {
+		auto arity = em.params[i].size();
+		os << "\t{f" << i << ", " << arity << ", ";
+		if (arity)
+			os << 'p' << i << "},\n";
+		else
+			os << "nullptr},\n";
+	}
+	os << "\t{}\n};\n";
+	for (auto &&func : em.funcs)
+		os << '\n' << func;
+	os << "\nrt::Value run(rt::Env &env) {\n\trt::Value res;\n" << body.str();
+	os << "\treturn res;\n}\n}\n\nint main() {\n\treturn rt::main(run, functions);\n}\n";
+	return true;
+}
+
+std::ostream &Emitter::line() {
+	return *os << std::string(indent, '\t');
+}
+
+std::string Emitter::tmp() {
+	return "t" + std::to_string(temp++);
+}
+
+std::string Emitter::symbol(const std::string &name) {
+	auto sym = symbols.emplace(name, symbols.size()).first;
+	return std::to_string(sym->second) + " /* " + name + " */";
+}
+
+std::string Emitter::loc(const yy::location &loc) {
+	std::ostringstream os;
+	os << '"' << loc << '"';
+	return os.str();
+}
+
+std::string Emitter::op_loc(const yy::location &loc) const {
+	return intrinsic ? "env.at" : Emitter::loc(loc);
+}
+
+void Emitter::open(const std::string &head) {
+	line() << head << (head.empty() ? "{\n" : " {\n");
+	++indent;
+}
+
+void Emitter::close(const std::string &tail) {
+	--indent;
+	line() << tail << '\n';
+}
+
+void Emitter::binop(const char *func, bool int_only, const Expr *lhs, const Expr *rhs,
+		const yy::location &loc, const std::string &dest) {
+	auto l = tmp();
+	auto r = tmp();
+	open("");
+	line() << "rt::Value " << l << ", " << r << ";\n";
+	lhs->emit(*this, l);
+	rhs->emit(*this, r);
+	line() << dest << " = rt::binop<" << func << (int_only ? ", true" : "") << ">("
+		<< l << ", " << r << ", " << op_loc(loc) << ");\n";
+	close();
+}
+
+void Emitter::unop(const char *func, bool int_only, const Expr *rhs, const yy::location &loc,
+		const std::string &dest) {
+	auto val = tmp();
+	open("");
+	line() << "rt::Value " << val << ";\n";
+	rhs->emit(*this, val);
+	line() << dest << " = rt::unop<" << func << (int_only ? ", true" : "") << ">("
+		<< val << ", " << op_loc(loc) << ");\n";
+	close();
+}
+
+void Empty::emit(Emitter &em, const std::string &dest) const {
+	em.line() << dest << " = {};\n";
+}
+
+void Scope::emit(Emitter &em, const std::string &dest) const {
+	// the program scope holds the globals
+	bool root = !parent_;
+	auto res = em.tmp();
+	em.targets.push_back({em.label++, res});
+	em.open("");
+	em.line() << "rt::Value " << res << ";\n";
+	if (!root)
+		em.line() << "env.push();\n";
+	if (blocks_)
+		blocks_->emit(em, res);
+	auto target = em.targets.back();
+	em.targets.pop_back();
+	if (target.used)
+		*em.os << std::string(em.indent - 1, '\t') << 'l' << target.id << ":\n";
+	if (!root)
+		em.line() << "env.pop();\n";
+	em.line() << dest << " = " << res << ";\n";
+	em.close();
+}
+
+void Seq::emit(Emitter &em, const std::string &dest) const {
+	auto seqs = chain(this);
+	auto tmp = em.tmp();
+	em.open("");
+	em.line() << "rt::Value " << tmp << ";\n";
+	seqs.back()->fst_->emit(em, tmp);
+	for (auto it = seqs.rbegin(), end = std::prev(seqs.rend()); it != end; ++it)
+		(*it)->snd_->emit(em, tmp);
+	em.close();
+	snd_->emit(em, dest);
+}
+
+void While::emit(Emitter &em, const std::string &dest) const {
+	auto cond = em.tmp();
+	auto tmp = em.tmp();
+	em.open("for (;;)");
+	em.line() << "rt::Value " << cond << ", " << tmp << ";\n";
+	expr_->emit(em, cond);
+	em.open("if (!rt::truth(" + cond + ", " + Emitter::loc(loc_) + "))");
+	em.line() << dest << " = " << cond << ";\n";
+	em.line() << "break;\n";
+	em.close();
+	block_->emit(em, tmp);
+	em.close();
+}
+
+void If::emit(Emitter &em, const std::string &dest) const {
+	auto cond = em.tmp();
+	em.open("");
+	em.line() << "rt::Value " << cond << ";\n";
+	expr_->emit(em, cond);
+	em.open("if (rt::truth(" + cond + ", " + Emitter::loc(loc_) + "))");
+	true_block_->emit(em, dest);
+	em.close();
+	em.open("else");
+	if (false_block_)
+		false_block_->emit(em, dest);
+	else
+		em.line() << dest << " = {};\n";
+	em.close();
+	em.close();
+}
+
+void Return::emit(Emitter &em, const std::string &dest) const {
+	auto target = em.targets.back();
+	expr_->emit(em, target.res);
+	em.targets.back().used = true;
+	em.line() << "goto l" << target.id << ";\n";
+}
+
+void ExprInt::emit(Emitter &em, const std::string &dest) const {
+	em.line() << dest << " = {" << Emitter::loc(loc_) << ", " << val_ << "};\n";
+}
+
+void ExprFloat::emit(Emitter &em, const std::string &dest) const {
+	em.line() << dest << " = {" << Emitter::loc(loc_) << ", " << std::hexfloat << val_
+		<< std::defaultfloat << "};\n";
+}
+
+void ExprId::emit(Emitter &em, const std::string &dest) const {
+	em.line() << dest << " = env.get(" << em.symbol(name_) << ");\n";
+}
+
+void ExprList::emit(Emitter &em, const std::string &dest) const {
+	auto args = em.tmp();
+	em.open("");
+	em.line() << "rt::Value " << args << '[' << size() << "];\n";
+	emit_args(em, args);
+	em.close();
+}
+
+void ExprList::emit_args(Emitter &em, const std::string &args) const {
+	std::size_t idx = 0;
+	for (auto list = this; list; list = list->tail_.get())
+		list->head_->emit(em, args + '[' + std::to_string(idx++) + ']');
+}
+
+void ExprFunc::emit(Emitter &em, const std::string &dest) const {
+	auto id = em.funcs.size();
+	em.funcs.emplace_back();
+	auto &&params = em.params.emplace_back();
+	for (auto it = decls_->cbegin(), end = decls_->cend(); it != end; ++it)
+		params.push_back(em.symbol(*it));
+
+	std::ostringstream code;
+	auto os = em.os;
+	auto indent = em.indent;
+	auto targets = std::move(em.targets);
+	em.os = &code;
+	em.indent = 1;
+	em.targets.clear();
+	em.intrinsic = intrinsic_;
+	code << "rt::Value f" << id << "(rt::Env &env) {\n\trt::Value res;\n";
+	body_->emit(em, "res");
+	code << "\treturn res;\n}\n";
+	em.intrinsic = false;
+	em.os = os;
+	em.indent = indent;
+	em.targets = std::move(targets);
+	em.funcs[id] = code.str();
+
+	em.line() << dest << " = rt::Value::func(" << Emitter::loc(loc_) << ", " << id << ");\n";
+	if (id_)
+		em.line() << (em.builtin ? "env.set_builtin(" : "env.set_global(")
+			<< em.symbol(id_->name_) << ", " << dest << ");\n";
+}
+
+void ExprQmark::emit(Emitter &em, const std::string &dest) const {
+	em.line() << dest << " = rt::read(" << Emitter::loc(loc_) << ");\n";
+}
+
+void ExprAssign::emit(Emitter &em, const std::string &dest) const {
+	expr_->emit(em, dest);
+	em.line() << "env.set(" << em.symbol(id_->name_) << ", " << dest << ");\n";
+}
+
+void ExprApply::emit(Emitter &em, const std::string &dest) const {
+	auto nargs = ops_ ? ops_->size() : 0;
+	auto args = em.tmp();
+	auto func = em.tmp();
+	em.open("");
+	if (nargs)
+		em.line() << "rt::Value " << args << '[' << nargs << "];\n";
+	em.line() << "rt::Value " << func << ";\n";
+	if (ops_)
+		ops_->emit_args(em, args);
+	id_->emit(em, func);
+	em.line() << dest << " = rt::call(env, " << func << ", " << (nargs ? args : "nullptr") << ", "
+		<< nargs << ", " << Emitter::loc(loc_) << ");\n";
+	em.close();
+}
+
+void Import::emit(Emitter &em, const std::string &dest) const {
+	em.builtin = module_->builtin;
+	for (auto &&func : module_->all())
+		func->emit(em, dest);
+	em.builtin = false;
+	em.line() << dest << " = {};\n";
+}
+
+void ExprNative::emit(Emitter &em, const std::string &dest) const {
+	throw std::logic_error("host functions are not supported by the C++ back end");
+}
+
+void Spawn::emit(Emitter &em, const std::string &dest) const {
+	throw std::logic_error("coroutines are not supported by the C++ back end");
+}
+
+void Yield::emit(Emitter &em, const std::string &dest) const {
+	throw std::logic_error("coroutines are not supported by the C++ back end");
+}
+
+void Join::emit(Emitter &em, const std::string &dest) const {
+	throw std::logic_error("coroutines are not supported by the C++ back end");
+}
+}
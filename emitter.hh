@@ -0,0 +1,45 @@
+#pragma once
+#include "location.hh"
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace AST {
+
+struct Expr;
+
+// State of the C++ back end: the function being emitted and the tables
+// shared by the whole translation unit
+struct Emitter {
+	struct Target {
+		unsigned id;
+		std::string res;
+		bool used = false;
+	};
+
+	std::ostringstream *os = nullptr;
+	int indent = 0;
+	std::map<std::string, int> symbols;
+	std::vector<std::string> funcs;
+	std::vector<std::vector<std::string>> params;
+	std::vector<Target> targets;
+	unsigned label = 0;
+	unsigned temp = 0;
+	// the named functions emitted are builtins instead of globals
+	bool builtin = false;
+	// the function emitted is an intrinsic, its errors go to the call
+	bool intrinsic = false;
+
+	std::ostream &line();
+	std::string tmp();
+	std::string symbol(const std::string &name);
+	static std::string loc(const yy::location &loc);
+	std::string op_loc(const yy::location &loc) const;
+	void open(const std::string &head);
+	void close(const std::string &tail = "}");
+	void binop(const char *func, bool int_only, const Expr *lhs, const Expr *rhs,
+		const yy::location &loc, const std::string &dest);
+	void unop(const char *func, bool int_only, const Expr *rhs, const yy::location &loc, const std::string &dest);
+};
+}
@@ -1,8 +1,21 @@
 #pragma once
 #include "ast.hh"
+#include "governor.hh"
+#include <cstddef>
+#include <ostream>
 #include <vector>
 
 namespace AST {
 
-void exec(const INode *root);
+void exec(INode *root);
+void walk(const INode *root);
+// true once the program is over, false at the end of a time slice
+bool exec(INode *root, Governor &gov);
+bool walk(const INode *root, Governor &gov);
+// open when a host program calls the functions after the program is run
+void infer(INode *root, bool open = false);
+std::size_t inline_calls(INode *root, std::size_t budget);
+std::size_t bind_calls(INode *root);
+void dump_types(const INode *root, std::ostream &os);
+bool emit_cpp(const INode *root, std::ostream &os);
 }
@@ -0,0 +1,82 @@
+#include "governor.hh"
+#include <algorithm>
+#include <string>
+
+namespace AST {
+
+bool Context::expire() {
+	if (!gov) {
+		countdown = -1;
+		return false;
+	}
+	return gov->check(*this);
+}
+
+std::size_t Governor::start() {
+	if (!limited())
+		return -1;
+	deadline = std::chrono::steady_clock::now() + time;
+	used = sliced = 0;
+	paused = false;
+	return granted = grant(0);
+}
+
+void Governor::arm(Context &ctxt) {
+	if (!limited())
+		return;
+	ctxt.gov = this;
+	if (depth)
+		ctxt.max_calls = depth;
+}
+
+bool Governor::check(Context &ctxt) {
+	used += granted;
+	if (steps && used > steps)
+		throw Context::Exceeded("more than " + std::to_string(steps) + " steps");
+	if (time.count() && std::chrono::steady_clock::now() > deadline)
+		throw Context::Exceeded("ran for more than " + std::to_string(time.count()) + " ms");
+	std::size_t cost = 0;
+	if (memory) {
+		std::size_t size = 0;
+		if (ctxt.sched)
+			for (auto &&task : ctxt.sched->tasks)
+				size += bytes(task.second->ctxt, cost);
+		else
+			size = bytes(ctxt, cost);
+		if (size > memory)
+			throw Context::Exceeded("stacks take more than " + std::to_string(memory) + " bytes");
+	}
+	paused = slice && (sliced += granted) >= slice;
+	if (paused)
+		sliced = 0;
+	ctxt.countdown = granted = grant(cost);
+	return paused;
+}
+
+std::size_t Governor::grant(std::size_t cost) const {
+	// looking at the stacks takes time in their size, spread it over as many steps
+	auto res = std::max(batch, cost);
+	if (steps)
+		res = std::min(res, steps - used + 1);
+	if (slice)
+		res = std::min(res, slice - sliced);
+	return res;
+}
+
+std::size_t Governor::bytes(const Context &ctxt, std::size_t &cost) {
+	// a variable is a hash node with its name and a value kept on the heap
+	constexpr auto var = sizeof(VarsT::value_type) + 2 * sizeof(void *) + sizeof(Values::Val<Func>);
+	auto scope = [&cost](const VarsT &vars) {
+		++cost;
+		return sizeof(VarsT) + vars.bucket_count() * sizeof(void *) + vars.size() * var;
+	};
+	auto res = ctxt.res.capacity() * sizeof(Value) + ctxt.res.size() * sizeof(Values::Val<Func>)
+		+ ctxt.call_stack.capacity() * sizeof(const Expr *);
+	for (auto &&vars : ctxt.scope_stack)
+		res += scope(vars);
+	for (auto &&scopes : ctxt.ctxts_stack)
+		for (auto &&vars : scopes)
+			res += scope(vars);
+	return res;
+}
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "ast.hh"
+#include "scheduler.hh"
+#include <chrono>
+#include <cstddef>
+#include <memory>
+
+namespace AST {
+
+// Limits exec() holds a program to, zero means no limit. A step is a loop
+// iteration or a call, the work between two of them is bounded by the size
+// of the program. Contexts count steps down and the governor only looks at
+// the clock and the stacks once per batch of them.
+struct Governor {
+	static constexpr std::size_t batch = 1024;
+	std::size_t steps = 0;
+	std::size_t depth = 0;
+	// bytes taken by the operand and scope stacks
+	std::size_t memory = 0;
+	std::chrono::milliseconds time{0};
+	// exec() returns after this many steps, the program continues on the
+	// next call with the same governor
+	std::size_t slice = 0;
+
+	std::size_t used = 0;
+	bool paused = false;
+	// the program stopped at the end of a slice
+	std::unique_ptr<Scheduler> sched;
+
+	bool limited() const {
+		return steps || depth || memory || time.count() || slice;
+	}
+	std::size_t start();
+	void arm(Context &ctxt);
+	bool check(Context &ctxt);
+private:
+	std::chrono::steady_clock::time_point deadline;
+	std::size_t granted = 0;
+	std::size_t sliced = 0;
+	std::size_t grant(std::size_t cost) const;
+	static std::size_t bytes(const Context &ctxt, std::size_t &cost);
+};
+}
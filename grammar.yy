@@ -59,6 +59,10 @@
 	ID
 	FUNC
 	RETURN
+	IMPORT
+	SPAWN
+	YIELD
+	JOIN
 
 %destructor { delete $$; } ID NUM FLOAT scope blocks block
 	stm cexpr fexpr expr func declist decls
@@ -74,9 +78,11 @@
 %left STAR SLASH PERCNT
 %precedence UNOP
 
+%initial-action { @$.initialize(driver.file); }
+
 %start program
 %%
-program : blocks END	{ driver.yylval = make<Scope>(@$, $1);	}
+program : blocks END	{ driver.yylval = driver.program(@$, $1);	}
 ;
 
 scope   : LBRACE blocks RBRACE 	{ $$ = make<Scope>(@$, $2);	}
@@ -89,6 +95,7 @@ blocks	: blocks block		{ $$ = make<Seq>(@$, $1, $2);	}
 block	: stm			{ $$ = $1;	}
 	| fexpr SEMICOLON	{ $$ = $1;	}
 	| SEMICOLON		{ $$ = make<Empty>(@$);	}
+	| IMPORT ID SEMICOLON	{ $$ = driver.import(@$, $2);	}
         | error 		{ $$ = make<Empty>(@$);	}
 ;
 
@@ -106,6 +113,9 @@ cexpr	: LPAR aexpr RPAR	{ $$ = $2; 	}
 	| QMARK			{ $$ = make<ExprQmark>(@$);			}
 	| RETURN expr		{ $$ = make<Return>(@$, $2);			}
 	| ID applist		{ $$ = make<ExprApply>(@$, $1, $2);		}
+	| SPAWN ID applist	{ $$ = make<Spawn>(@$, $2, $3);			}
+	| YIELD			{ $$ = make<Yield>(@$);				}
+	| JOIN	expr %prec UNOP	{ $$ = make<Join>(@$, $2);			}
 	| PRINT expr		{ $$ = make<ExprUnOp<UnOpPrint	>>(@$, $2);	}
 	| PLUS	expr %prec UNOP	{ $$ = make<ExprUnOp<UnOpPlus	>>(@$, $2);	}
 	| MINUS	expr %prec UNOP	{ $$ = make<ExprUnOp<UnOpMinus	>>(@$, $2);	}
@@ -173,5 +183,6 @@ exprs	: exprs COMA expr	{ $$ = make<ExprList>(@$, $1, $3);			}
 %%
 
 void yy::parser::error(const location_type &loc, const std::string &err_message) {
+	++driver.errors;
 	std::cerr << "Error: " << err_message << " at " << loc << std::endl;
 }
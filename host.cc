@@ -0,0 +1,80 @@
+#include "paracl.hh"
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Example of a host program: runs a ParaCL program through the library,
+// then calls one of its functions with the numbers given
+//	host.out [--repeat=N] file.pc [function args...]
+// Scripts may call hypot(x, y) of the host.
+int main(int argc, char **argv) {
+	std::size_t repeat = 1;
+	int arg = 1;
+	if (arg < argc && std::string{argv[arg]}.rfind("--repeat=", 0) == 0)
+		repeat = std::stoul(std::string{argv[arg++]}.substr(9));
+	if (arg >= argc) {
+		std::cerr << "Usage: " << argv[0] << " [--repeat=N] file.pc [function args...]" << std::endl;
+		return 1;
+	}
+	std::vector<paracl::Native> natives{
+		{"hypot", 2, [](const paracl::Number *args) -> paracl::Number {
+			auto num = [](auto val) -> double {
+				return val;
+			};
+			return std::hypot(std::visit(num, args[0]), std::visit(num, args[1]));
+		}},
+	};
+	paracl::IO io{
+		[]() -> std::optional<int> {
+			int val;
+			if (std::cin >> val)
+				return val;
+			return std::nullopt;
+		},
+		[](const paracl::Number &val) {
+			std::visit([](auto val) {
+				std::cout << val << std::endl;
+			}, val);
+		},
+	};
+	try {
+		std::ifstream file{argv[arg]};
+		paracl::Program prog{file, natives};
+		paracl::Context ctxt{prog, io};
+		ctxt.run();
+		if (++arg == argc)
+			return 0;
+		std::string name{argv[arg]};
+		std::vector<paracl::Number> args;
+		while (++arg < argc) {
+			std::string num{argv[arg]};
+			if (num.find_first_of(".eE") == std::string::npos)
+				args.push_back(std::stoi(num));
+			else
+				args.push_back(std::stod(num));
+		}
+		std::optional<paracl::Number> res;
+		auto start = std::chrono::steady_clock::now();
+		for (std::size_t i = 0; i < repeat; ++i)
+			res = ctxt.call(name, args);
+		std::chrono::nanoseconds time = std::chrono::steady_clock::now() - start;
+		if (res)
+			std::visit([](auto val) {
+				std::cout << val << std::endl;
+			}, *res);
+		else
+			std::cout << "undefined" << std::endl;
+		if (repeat > 1)
+			std::cerr << repeat << " calls, " << time.count() / repeat << " ns per call" << std::endl;
+	} catch (const paracl::Error &err) {
+		std::cout << err.what() << std::endl;
+		return 1;
+	} catch (const std::logic_error &err) {
+		std::cerr << "Bad argument: " << err.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
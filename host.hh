@@ -0,0 +1,26 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <string>
+#include <variant>
+
+namespace AST {
+
+// What a host program passes to ParaCL and gets back
+using Number = std::variant<int, double>;
+
+// A function of the host program, scripts call it by name like their own
+struct Native {
+	std::string name;
+	std::size_t arity;
+	std::function<Number (const Number *args)> call;
+};
+
+// Callbacks of the host program for ? and print, a missing one is the
+// standard stream. No input gives an undefined value like a failed read.
+struct IO {
+	std::function<std::optional<int> ()> input;
+	std::function<void (const Number &val)> print;
+};
+}
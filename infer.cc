@@ -0,0 +1,565 @@
+#include "ast.hh"
+#include "exec.hh"
+#include <algorithm>
+
+namespace AST {
+
+void infer(INode *root, bool open) {
+	auto expr = static_cast<Expr *>(root);
+	Infer in;
+	in.open = open;
+	do {
+		++in.iter;
+		in.changed = false;
+		in.state = {};
+		// the program is task 0, a join may give its result too
+		if (in.tasks.join(expr->analyze(in)))
+			in.changed = true;
+	} while (in.changed);
+}
+
+void dump_types(const INode *root, std::ostream &os) {
+	static_cast<const Expr *>(root)->dump(os, 0);
+}
+
+bool Infer::join(VarsT &lhs, const VarsT &rhs) {
+	bool changed = false;
+	for (auto &&[name, t] : lhs) {
+		auto var = rhs.find(name);
+		if (var == rhs.end()) {
+			changed |= !t.may(Types::Absent);
+			t.bits |= Types::Absent;
+		} else
+			changed |= t.join(var->second);
+	}
+	for (auto &&[name, t] : rhs)
+		if (lhs.find(name) == lhs.end()) {
+			auto &&cur = lhs[name] = t;
+			cur.bits |= Types::Absent;
+			changed = true;
+		}
+	return changed;
+}
+
+bool Infer::join(ImportsT &lhs, const ImportsT &rhs) {
+	if (lhs == rhs)
+		return false;
+	auto pos = [](const ImportsT &imports, Module *module) {
+		return static_cast<std::size_t>(std::find_if(imports.begin(), imports.end(), [&](auto &&cur) {
+			return cur.first == module;
+		}) - imports.begin());
+	};
+	auto res = lhs;
+	for (auto &&[module, certain] : rhs)
+		if (pos(lhs, module) == lhs.size())
+			res.emplace_back(module, false);
+	// a module hides the ones before it if it comes after them on both paths
+	for (std::size_t i = 0; i < res.size(); ++i) {
+		auto &&[module, certain] = res[i];
+		auto j = pos(rhs, module);
+		if (j == rhs.size() || !rhs[j].second)
+			certain = false;
+		for (auto k = j + 1; certain && k < rhs.size(); ++k)
+			certain = pos(res, rhs[k].first) > i;
+	}
+	bool changed = res != lhs;
+	lhs = std::move(res);
+	return changed;
+}
+
+void Infer::State::join(const State &rhs) {
+	if (!rhs.live)
+		return;
+	if (!live) {
+		*this = rhs;
+		return;
+	}
+	for (std::size_t i = 0; i < env.size(); ++i)
+		Infer::join(env[i], rhs.env[i]);
+	Infer::join(imports, rhs.imports);
+}
+
+Types Infer::read(const std::string &name) const {
+	Types res;
+	auto &&env = state.env;
+	for (auto it = env.rbegin(), end = env.rend(); it != end; ++it) {
+		auto var = it->find(name);
+		if (var == it->end())
+			continue;
+		res.join(var->second);
+		if (!var->second.may(Types::Absent)) {
+			res.bits &= ~Types::Absent;
+			return res;
+		}
+	}
+	auto funcs = imported(name);
+	res.join(funcs);
+	res.bits &= ~Types::Absent;
+	if (funcs.bits != Types::None && !funcs.may(Types::Absent))
+		return res;
+	auto builtin = builtins.find(name);
+	if (builtin != builtins.end())
+		res.join(builtin->second);
+	else
+		res.bits |= Types::Udef;
+	return res;
+}
+
+// functions the imports give a global that is not set
+Types Infer::imported(const std::string &name) const {
+	Types res;
+	for (auto it = state.imports.rbegin(), end = state.imports.rend(); it != end; ++it)
+		if (auto func = it->first->func(name)) {
+			res.join(Types{func});
+			if (it->second)
+				return res;
+		}
+	if (res.bits != Types::None)
+		res.bits |= Types::Absent;
+	return res;
+}
+
+void Infer::write(const std::string &name, const Types &t) {
+	auto &&env = state.env;
+	// the global of an imported function is defined before it is written
+	if (!env.front().count(name))
+		if (auto funcs = imported(name); funcs.bits != Types::None)
+			env.front().emplace(name, funcs);
+	bool certain = true;
+	for (auto i = env.size(); i-- > 0;) {
+		auto var = env[i].find(name);
+		if (var == env[i].end())
+			continue;
+		auto &&cur = var->second;
+		bool present = !cur.may(Types::Absent);
+		if (certain && present)
+			cur = t;
+		else
+			cur.join(t);
+		if (i == 0)
+			record(name, t);
+		if (present)
+			return;
+		certain = false;
+	}
+	auto &&vars = env.back();
+	if (vars.find(name) == vars.end()) {
+		auto &&cur = vars[name] = t;
+		if (!certain)
+			cur.bits |= Types::Absent;
+	}
+}
+
+void Infer::write_global(const std::string &name, const Types &t) {
+	state.env.front()[name] = t;
+	record(name, t);
+}
+
+void Infer::record(const std::string &name, const Types &t) {
+	if (!frames.empty() && frames.back()->writes[name].join(t))
+		changed = true;
+}
+
+void Infer::merge(const VarsT &writes) {
+	auto &&globals = state.env.front();
+	for (auto &&[name, t] : writes) {
+		auto var = globals.find(name);
+		if (var == globals.end()) {
+			auto &&cur = globals[name] = t;
+			cur.bits |= Types::Absent;
+		} else
+			var->second.join(t);
+		record(name, t);
+	}
+}
+
+void Infer::import(Module *module, bool certain) {
+	// the globals it defines are dropped at runtime
+	for (auto &&[name, t] : state.env.front())
+		if (auto func = module->func(name)) {
+			if (certain)
+				t = Types{func};
+			else
+				t.join(Types{func});
+			record(name, t);
+		}
+	auto &&imports = state.imports;
+	imports.erase(std::remove_if(imports.begin(), imports.end(), [&](auto &&cur) {
+		return cur.first == module;
+	}), imports.end());
+	imports.emplace_back(module, certain);
+	if (frames.empty())
+		return;
+	auto &&opened = frames.back()->opened;
+	if (std::find(opened.begin(), opened.end(), module) == opened.end()) {
+		opened.push_back(module);
+		changed = true;
+	}
+}
+
+void Infer::ret(const Types &t) {
+	auto &&target = targets.back();
+	target.state.join(state);
+	target.res.join(t);
+	state.live = false;
+}
+
+void Infer::call_globals() {
+	// as if the program ended in a loop calling every function with numbers
+	auto head = state;
+	for (;;) {
+		auto globals = state.env.front();
+		globals.insert(builtins.begin(), builtins.end());
+		for (auto &&[module, certain] : state.imports)
+			for (auto &&func : module->all())
+				globals.emplace(func->name(), Types{func});
+		for (auto &&[name, t] : globals)
+			for (auto &&func : t.funcs)
+				func->call(*this, std::vector<Types>(func->arity(), Types(Types::Int | Types::Double)));
+		auto next = head;
+		next.join(state);
+		if (next == head)
+			return;
+		head = next;
+		state = std::move(next);
+	}
+}
+
+Types Expr::analyze(Infer &in) {
+	if (!in.state.live)
+		return {};
+	auto res = infer(in);
+	if (!in.state.live)
+		return {};
+	type_.join(res);
+	return res;
+}
+
+void Expr::dump_head(std::ostream &os, int depth, const std::string &name) const {
+	os << std::string(2 * depth, ' ') << name << ' ' << loc_ << ": " << type_ << std::endl;
+}
+
+Types Empty::infer(Infer &in) {
+	return Types::Udef;
+}
+
+void Empty::dump(std::ostream &os, int depth) const {
+	dump_head(os, depth, "Empty");
+}
+
+Types Scope::infer(Infer &in) {
+	if (!blocks_)
+		return Types::Udef;
+	in.state.env.emplace_back();
+	in.targets.emplace_back();
+	auto res = blocks_->analyze(in);
+	auto target = std::move(in.targets.back());
+	in.targets.pop_back();
+	in.state.join(target.state);
+	res.join(target.res);
+	// the host calls into the globals the program leaves
+	if (in.open && !parent_ && in.state.live)
+		in.call_globals();
+	if (in.state.live)
+		in.state.env.pop_back();
+	return res;
+}
+
+void Scope::dump(std::ostream &os, int depth) const {
+	dump_head(os, depth, "Scope");
+	if (blocks_)
+		blocks_->dump(os, depth + 1);
+}
+
+Types Seq::infer(Infer &in) {
+	auto seqs = chain(this);
+	seqs.back()->fst_->analyze(in);
+	Types res;
+	for (auto it = seqs.rbegin(), end = seqs.rend(); it != end; ++it) {
+		res = (*it)->snd_->analyze(in);
+		// what analyze() does for the nested sequences
+		if (*it != this && in.state.live)
+			(*it)->type_.join(res);
+	}
+	return res;
+}
+
+void Seq::dump(std::ostream &os, int depth) const {
+	auto seqs = chain(this);
+	seqs.back()->fst_->dump(os, depth);
+	for (auto it = seqs.rbegin(), end = seqs.rend(); it != end; ++it)
+		(*it)->snd_->dump(os, depth);
+}
+
+Types While::infer(Infer &in) {
+	Types res;
+	auto head = in.state;
+	for (;;) {
+		in.state = head;
+		auto cond = expr_->analyze(in);
+		res.join(cond);
+		if (numeric(cond).bits == Types::None)
+			in.state.live = false;
+		if (!in.state.live)
+			return res;
+		auto exit = in.state;
+		block_->analyze(in);
+		auto next = head;
+		next.join(in.state);
+		if (next == head) {
+			in.state = std::move(exit);
+			return res;
+		}
+		head = std::move(next);
+	}
+}
+
+void While::dump(std::ostream &os, int depth) const {
+	dump_head(os, depth, "While");
+	expr_->dump(os, depth + 1);
+	block_->dump(os, depth + 1);
+}
+
+Types If::infer(Infer &in) {
+	auto cond = expr_->analyze(in);
+	if (numeric(cond).bits == Types::None)
+		in.state.live = false;
+	auto state = in.state;
+	auto res = true_block_->analyze(in);
+	std::swap(state, in.state);
+	if (false_block_)
+		res.join(false_block_->analyze(in));
+	else
+		res.join(Types::Udef);
+	in.state.join(state);
+	return res;
+}
+
+void If::dump(std::ostream &os, int depth) const {
+	dump_head(os, depth, "If");
+	expr_->dump(os, depth + 1);
+	true_block_->dump(os, depth + 1);
+	if (false_block_)
+		false_block_->dump(os, depth + 1);
+}
+
+Types Return::infer(Infer &in) {
+	auto res = expr_->analyze(in);
+	if (in.state.live)
+		in.ret(res);
+	return {};
+}
+
+void Return::dump(std::ostream &os, int depth) const {
+	dump_head(os, depth, "Return");
+	expr_->dump(os, depth + 1);
+}
+
+Types ExprInt::infer(Infer &in) {
+	return Types::Int;
+}
+
+void ExprInt::dump(std::ostream &os, int depth) const {
+	dump_head(os, depth, "Int " + std::to_string(val_));
+}
+
+Types ExprFloat::infer(Infer &in) {
+	return Types::Double;
+}
+
+void ExprFloat::dump(std::ostream &os, int depth) const {
+	dump_head(os, depth, "Float " + std::to_string(val_));
+}
+
+Types ExprId::infer(Infer &in) {
+	return in.read(name_);
+}
+
+void ExprId::dump(std::ostream &os, int depth) const {
+	dump_head(os, depth, "Id " + name_);
+}
+
+Types ExprList::infer(Infer &in) {
+	std::vector<Types> args;
+	infer_args(in, args);
+	return {};
+}
+
+void ExprList::infer_args(Infer &in, std::vector<Types> &args) {
+	for (auto list = this; list; list = list->tail_.get())
+		args.push_back(list->head_->analyze(in));
+}
+
+void ExprList::dump(std::ostream &os, int depth) const {
+	std::vector<const Expr *> args;
+	for (auto list = this; list; list = list->tail_.get())
+		args.push_back(list->head_.get());
+	for (auto it = args.rbegin(), end = args.rend(); it != end; ++it)
+		(*it)->dump(os, depth);
+}
+
+Types ExprFunc::infer(Infer &in) {
+	Types res{this};
+	if (id_)
+		in.write_global(id_->name_, res);
+	return res;
+}
+
+Types ExprFunc::call(Infer &in, const std::vector<Types> &args) {
+	auto &&sum = in.funcs[this];
+	bool grew = false;
+	if (!sum.called) {
+		sum.called = grew = true;
+		sum.params = args;
+		sum.globals = in.state.env.front();
+		sum.imports = in.state.imports;
+	} else {
+		for (std::size_t i = 0; i < args.size(); ++i)
+			grew |= sum.params[i].join(args[i]);
+		grew |= Infer::join(sum.globals, in.state.env.front());
+		grew |= Infer::join(sum.imports, in.state.imports);
+	}
+	if (grew)
+		in.changed = true;
+	if ((grew || sum.iter != in.iter) && !sum.active) {
+		sum.iter = in.iter;
+		sum.active = true;
+		Infer::State callee{{sum.globals, {}}, true, sum.imports};
+		auto &&params = callee.env.back();
+		auto arg = sum.params.cbegin();
+		for (auto it = decls_->cbegin(), end = decls_->cend(); it != end; ++it)
+			params.emplace(*it, *arg++);
+		std::swap(callee, in.state);
+		in.frames.push_back(&sum);
+		auto res = body_->analyze(in);
+		in.frames.pop_back();
+		std::swap(callee, in.state);
+		sum.active = false;
+		if (sum.res.join(res))
+			in.changed = true;
+	}
+	in.merge(sum.writes);
+	for (auto &&module : sum.opened)
+		in.import(module, false);
+	// the body sums up every call, the operator of an intrinsic tells each one
+	return intrinsic_ ? intrinsic_->infer(args) : sum.res;
+}
+
+void ExprFunc::dump(std::ostream &os, int depth) const {
+	std::string head = "Func(";
+	auto sep = "";
+	for (auto it = decls_->cbegin(), end = decls_->cend(); it != end; ++it) {
+		head += sep + *it;
+		sep = ", ";
+	}
+	head += ")";
+	if (id_)
+		head += " : " + id_->name_;
+	dump_head(os, depth, head);
+	body_->dump(os, depth + 1);
+}
+
+Types ExprQmark::infer(Infer &in) {
+	return Types::Int | Types::Udef;
+}
+
+void ExprQmark::dump(std::ostream &os, int depth) const {
+	dump_head(os, depth, "Qmark");
+}
+
+Types ExprAssign::infer(Infer &in) {
+	auto res = expr_->analyze(in);
+	if (in.state.live)
+		in.write(id_->name_, res);
+	return res;
+}
+
+void ExprAssign::dump(std::ostream &os, int depth) const {
+	dump_head(os, depth, "Assign " + id_->name_);
+	expr_->dump(os, depth + 1);
+}
+
+Types ExprApply::infer(Infer &in) {
+	std::vector<Types> args;
+	if (ops_)
+		ops_->infer_args(in, args);
+	auto func = id_->analyze(in);
+	if (!in.state.live)
+		return {};
+	// arguments are evaluated starting from the last one
+	std::reverse(args.begin(), args.end());
+	Types res;
+	for (auto &&callee : func.funcs)
+		if (callee->arity() == args.size())
+			res.join(callee->call(in, args));
+	if (res.bits == Types::None)
+		in.state.live = false;
+	return res;
+}
+
+void ExprApply::dump(std::ostream &os, int depth) const {
+	dump_head(os, depth, "Apply " + id_->name_);
+	if (ops_)
+		ops_->dump(os, depth + 1);
+}
+
+Types Import::infer(Infer &in) {
+	if (module_->builtin)
+		for (auto &&func : module_->loaded())
+			in.builtins[func->name()] = Types{func};
+	else
+		in.import(module_, true);
+	return Types::Udef;
+}
+
+void Import::dump(std::ostream &os, int depth) const {
+	dump_head(os, depth, "Import " + name_);
+}
+
+Types ExprNative::infer(Infer &in) {
+	return Types::Int | Types::Double;
+}
+
+void ExprNative::dump(std::ostream &os, int depth) const {
+	dump_head(os, depth, "Native " + native_->name);
+}
+
+Types Spawn::infer(Infer &in) {
+	std::vector<Types> args;
+	if (ops_)
+		ops_->infer_args(in, args);
+	auto func = id_->analyze(in);
+	if (!in.state.live)
+		return {};
+	std::reverse(args.begin(), args.end());
+	// analyzed as a call, its writes to the globals are kept to stay conservative
+	for (auto &&callee : func.funcs)
+		if (callee->arity() == args.size() && in.tasks.join(callee->call(in, args)))
+			in.changed = true;
+	return Types::Int;
+}
+
+void Spawn::dump(std::ostream &os, int depth) const {
+	dump_head(os, depth, "Spawn " + id_->name_);
+	if (ops_)
+		ops_->dump(os, depth + 1);
+}
+
+Types Yield::infer(Infer &in) {
+	return Types::Udef;
+}
+
+void Yield::dump(std::ostream &os, int depth) const {
+	dump_head(os, depth, "Yield");
+}
+
+Types Join::infer(Infer &in) {
+	expr_->analyze(in);
+	return in.tasks;
+}
+
+void Join::dump(std::ostream &os, int depth) const {
+	dump_head(os, depth, "Join");
+	expr_->dump(os, depth + 1);
+}
+}
@@ -0,0 +1,396 @@
+#include "ast.hh"
+#include "exec.hh"
+#include <algorithm>
+
+namespace AST {
+
+std::size_t inline_calls(INode *root, std::size_t budget) {
+	auto expr = static_cast<Expr *>(root);
+	Inliner in{budget};
+	// variables assigned in nested scopes of the program may shadow globals
+	Inliner::Info info;
+	info.local_depth = 2;
+	expr->scan(info);
+	in.frames.push_back(std::move(info.locals));
+	expr->inline_calls(in);
+	return in.count;
+}
+
+void Inliner::visit(std::unique_ptr<Expr> &slot) {
+	slot->inline_calls(*this);
+	if (auto res = slot->expand(*this)) {
+		res->parent_ = slot->parent_;
+		slot.reset(res);
+	}
+}
+
+void Empty::scan(Inliner::Info &info) const {
+	info.enter();
+}
+
+Expr *Empty::clone(const Inliner::Renames &names) const {
+	return new Empty{loc_};
+}
+
+void Empty::inline_calls(Inliner &in) {
+}
+
+void Scope::scan(Inliner::Info &info) const {
+	if (!info.enter() || !blocks_)
+		return;
+	++info.depth;
+	blocks_->scan(info);
+	--info.depth;
+}
+
+Expr *Scope::clone(const Inliner::Renames &names) const {
+	return new Scope{loc_, blocks_->clone(names)};
+}
+
+void Scope::inline_calls(Inliner &in) {
+	if (blocks_)
+		in.visit(blocks_);
+}
+
+void Seq::scan(Inliner::Info &info) const {
+	auto seqs = chain(this);
+	for (std::size_t i = 0; i < seqs.size(); ++i)
+		if (!info.enter())
+			return;
+	seqs.back()->fst_->scan(info);
+	for (auto it = seqs.rbegin(), end = seqs.rend(); it != end; ++it)
+		(*it)->snd_->scan(info);
+}
+
+Expr *Seq::clone(const Inliner::Renames &names) const {
+	auto seqs = chain(this);
+	auto res = seqs.back()->fst_->clone(names);
+	for (auto it = seqs.rbegin(), end = seqs.rend(); it != end; ++it)
+		res = new Seq{(*it)->loc_, res, (*it)->snd_->clone(names)};
+	return res;
+}
+
+void Seq::inline_calls(Inliner &in) {
+	auto seqs = chain(this);
+	in.visit(seqs.back()->fst_);
+	for (auto it = seqs.rbegin(), end = seqs.rend(); it != end; ++it)
+		in.visit((*it)->snd_);
+}
+
+void While::scan(Inliner::Info &info) const {
+	if (!info.enter())
+		return;
+	expr_->scan(info);
+	block_->scan(info);
+}
+
+Expr *While::clone(const Inliner::Renames &names) const {
+	return new While{loc_, expr_->clone(names), block_->clone(names)};
+}
+
+void While::inline_calls(Inliner &in) {
+	in.visit(expr_);
+	in.visit(block_);
+}
+
+void If::scan(Inliner::Info &info) const {
+	if (!info.enter())
+		return;
+	expr_->scan(info);
+	true_block_->scan(info);
+	if (false_block_)
+		false_block_->scan(info);
+}
+
+Expr *If::clone(const Inliner::Renames &names) const {
+	return new If{loc_, expr_->clone(names), true_block_->clone(names),
+		false_block_ ? false_block_->clone(names) : nullptr};
+}
+
+void If::inline_calls(Inliner &in) {
+	in.visit(expr_);
+	in.visit(true_block_);
+	if (false_block_)
+		in.visit(false_block_);
+}
+
+void Return::scan(Inliner::Info &info) const {
+	if (!info.enter())
+		return;
+	if (info.depth == 0)
+		info.returns = true;
+	expr_->scan(info);
+}
+
+Expr *Return::clone(const Inliner::Renames &names) const {
+	return new Return{loc_, expr_->clone(names)};
+}
+
+void Return::inline_calls(Inliner &in) {
+	in.visit(expr_);
+}
+
+void ExprInt::scan(Inliner::Info &info) const {
+	info.enter();
+}
+
+Expr *ExprInt::clone(const Inliner::Renames &names) const {
+	return new ExprInt{loc_, val_};
+}
+
+void ExprInt::inline_calls(Inliner &in) {
+}
+
+void ExprFloat::scan(Inliner::Info &info) const {
+	info.enter();
+}
+
+Expr *ExprFloat::clone(const Inliner::Renames &names) const {
+	return new ExprFloat{loc_, val_};
+}
+
+void ExprFloat::inline_calls(Inliner &in) {
+}
+
+void ExprId::scan(Inliner::Info &info) const {
+	if (info.enter())
+		info.names.insert(name_);
+}
+
+ExprId *ExprId::clone(const Inliner::Renames &names) const {
+	auto name = names.find(name_);
+	return new ExprId{loc_, name == names.end() ? name_ : name->second};
+}
+
+void ExprId::inline_calls(Inliner &in) {
+}
+
+void ExprList::scan(Inliner::Info &info) const {
+	for (auto list = this; list; list = list->tail_.get()) {
+		if (!info.enter())
+			return;
+		list->head_->scan(info);
+	}
+}
+
+Expr *ExprList::clone(const Inliner::Renames &names) const {
+	std::vector<const ExprList *> lists;
+	for (auto list = this; list; list = list->tail_.get())
+		lists.push_back(list);
+	ExprList *res = nullptr;
+	for (auto it = lists.rbegin(), end = lists.rend(); it != end; ++it)
+		res = new ExprList{(*it)->loc_, res, (*it)->head_->clone(names)};
+	return res;
+}
+
+void ExprList::inline_calls(Inliner &in) {
+	for (auto list = this; list; list = list->tail_.get())
+		in.visit(list->head_);
+}
+
+void ExprList::release(std::vector<std::unique_ptr<Expr>> &args) {
+	for (auto list = this; list; list = list->tail_.get())
+		args.push_back(std::move(list->head_));
+}
+
+void ExprFunc::scan(Inliner::Info &info) const {
+	if (!info.enter())
+		return;
+	info.funcs = true;
+	if (id_)
+		info.defines.push_back(const_cast<ExprFunc *>(this));
+}
+
+Expr *ExprFunc::clone(const Inliner::Renames &names) const {
+	return new ExprFunc{loc_, body_->clone({}), new DeclList{*decls_},
+		id_ ? id_->clone({}) : nullptr};
+}
+
+void ExprFunc::inline_calls(Inliner &in) {
+	Inliner::Info info;
+	info.local_depth = 1;
+	body_->scan(info);
+	info.locals.insert(decls_->cbegin(), decls_->cend());
+	in.frames.push_back(std::move(info.locals));
+	body_->inline_calls(in);
+	in.frames.pop_back();
+}
+
+bool ExprFunc::inlinable(Inliner &in, std::size_t nargs) const {
+	// calls of intrinsics are left to the binder
+	if (!id_ || intrinsic_ || arity() != nargs)
+		return false;
+	std::set<std::string> params{decls_->cbegin(), decls_->cend()};
+	if (params.size() != nargs)
+		return false;
+	Inliner::Info info;
+	info.limit = in.budget;
+	body_->scan(info);
+	if (info.size > in.budget || info.funcs || info.calls.count(const_cast<ExprFunc *>(this)))
+		return false;
+	// the body must not see variables local to the caller
+	auto &&locals = in.frames.back();
+	return std::none_of(info.names.begin(), info.names.end(), [&](auto &&name) {
+		return !params.count(name) && locals.count(name);
+	});
+}
+
+Expr *ExprFunc::expand(Inliner &in, std::vector<std::unique_ptr<Expr>> &args, LocT loc) const {
+	Inliner::Renames names;
+	auto suffix = "'" + std::to_string(++in.fresh);
+	for (auto it = decls_->cbegin(), end = decls_->cend(); it != end; ++it)
+		names.emplace(*it, *it + suffix);
+	INode *blocks = new Empty{loc};
+	// arguments come in evaluation order, that is starting from the last one
+	auto decl = decls_->cend();
+	for (auto &&arg : args) {
+		--decl;
+		auto id = new ExprId{arg->loc_, names[*decl]};
+		blocks = new Seq{loc, blocks, new ExprAssign{arg->loc_, id, arg.release()}};
+	}
+	blocks = new Seq{loc, blocks, body_->clone(names)};
+	++in.count;
+	return new Scope{loc, blocks};
+}
+
+void ExprQmark::scan(Inliner::Info &info) const {
+	info.enter();
+}
+
+Expr *ExprQmark::clone(const Inliner::Renames &names) const {
+	return new ExprQmark{loc_};
+}
+
+void ExprQmark::inline_calls(Inliner &in) {
+}
+
+void ExprAssign::scan(Inliner::Info &info) const {
+	if (!info.enter())
+		return;
+	info.names.insert(id_->name_);
+	if (info.depth == 0)
+		info.assigns = true;
+	if (info.depth >= info.local_depth)
+		info.locals.insert(id_->name_);
+	expr_->scan(info);
+}
+
+Expr *ExprAssign::clone(const Inliner::Renames &names) const {
+	return new ExprAssign{loc_, id_->clone(names), expr_->clone(names)};
+}
+
+void ExprAssign::inline_calls(Inliner &in) {
+	in.visit(expr_);
+}
+
+void ExprApply::scan(Inliner::Info &info) const {
+	if (!info.enter())
+		return;
+	info.names.insert(id_->name_);
+	info.calls.insert(id_->type_.funcs.begin(), id_->type_.funcs.end());
+	if (ops_)
+		ops_->scan(info);
+}
+
+Expr *ExprApply::clone(const Inliner::Renames &names) const {
+	return new ExprApply{loc_, id_->clone(names), ops_ ? ops_->clone(names) : nullptr};
+}
+
+void ExprApply::inline_calls(Inliner &in) {
+	if (ops_)
+		ops_->inline_calls(in);
+}
+
+Expr *ExprApply::expand(Inliner &in) {
+	auto &&func = id_->type_;
+	if (func.bits != Types::Func || func.funcs.size() != 1)
+		return nullptr;
+	auto callee = *func.funcs.begin();
+	if (!callee->inlinable(in, ops_ ? ops_->size() : 0))
+		return nullptr;
+	std::vector<std::unique_ptr<Expr>> args;
+	if (ops_) {
+		// arguments are moved into a new scope, they must not define variables
+		Inliner::Info info;
+		ops_->scan(info);
+		if (info.assigns || info.returns)
+			return nullptr;
+		ops_->release(args);
+	}
+	return callee->expand(in, args, loc_);
+}
+
+void Import::scan(Inliner::Info &info) const {
+	if (!info.enter())
+		return;
+	info.funcs = true;
+	info.imports.emplace_back(info.defines.size(), name_);
+}
+
+Expr *Import::clone(const Inliner::Renames &names) const {
+	return new Import{loc_, name_, module_};
+}
+
+void Import::inline_calls(Inliner &in) {
+}
+
+void ExprNative::scan(Inliner::Info &info) const {
+	if (info.enter())
+		info.names.insert(params_.begin(), params_.end());
+}
+
+Expr *ExprNative::clone(const Inliner::Renames &names) const {
+	auto params = params_;
+	for (auto &&param : params) {
+		auto name = names.find(param);
+		if (name != names.end())
+			param = name->second;
+	}
+	return new ExprNative{loc_, native_, std::move(params)};
+}
+
+void ExprNative::inline_calls(Inliner &in) {
+}
+
+void Spawn::scan(Inliner::Info &info) const {
+	if (!info.enter())
+		return;
+	info.names.insert(id_->name_);
+	info.calls.insert(id_->type_.funcs.begin(), id_->type_.funcs.end());
+	if (ops_)
+		ops_->scan(info);
+}
+
+Expr *Spawn::clone(const Inliner::Renames &names) const {
+	return new Spawn{loc_, id_->clone(names), ops_ ? ops_->clone(names) : nullptr};
+}
+
+void Spawn::inline_calls(Inliner &in) {
+	if (ops_)
+		ops_->inline_calls(in);
+}
+
+void Yield::scan(Inliner::Info &info) const {
+	info.enter();
+}
+
+Expr *Yield::clone(const Inliner::Renames &names) const {
+	return new Yield{loc_};
+}
+
+void Yield::inline_calls(Inliner &in) {
+}
+
+void Join::scan(Inliner::Info &info) const {
+	if (info.enter())
+		expr_->scan(info);
+}
+
+Expr *Join::clone(const Inliner::Renames &names) const {
+	return new Join{loc_, expr_->clone(names)};
+}
+
+void Join::inline_calls(Inliner &in) {
+	in.visit(expr_);
+}
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace AST {
+
+struct Expr;
+struct ExprFunc;
+
+struct Inliner {
+	using Renames = std::map<std::string, std::string>;
+
+	// What a subtree does to the scopes it is evaluated in
+	struct Info {
+		std::size_t size = 0;
+		std::size_t limit = -1;
+		int depth = 0;
+		int local_depth = 0;
+		std::set<std::string> names;
+		std::set<std::string> locals;
+		std::set<ExprFunc *> calls;
+		// named functions, in the order they are defined
+		std::vector<ExprFunc *> defines;
+		// modules imported, each after as many defines
+		std::vector<std::pair<std::size_t, std::string>> imports;
+		bool assigns = false;
+		bool returns = false;
+		bool funcs = false;
+		bool enter() {
+			return ++size <= limit;
+		}
+	};
+
+	std::size_t budget;
+	std::vector<std::set<std::string>> frames;
+	unsigned fresh = 0;
+	std::size_t count = 0;
+
+	Inliner(std::size_t b) : budget(b) {
+	}
+	void visit(std::unique_ptr<Expr> &slot);
+};
+}
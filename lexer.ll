@@ -49,6 +49,10 @@ id	[a-zA-Z_][a-zA-Z_0-9]*
 "else"		return yy::parser::token::TOK_ELSE;
 "func"		return yy::parser::token::TOK_FUNC;
 "return"	return yy::parser::token::TOK_RETURN;
+"import"	return yy::parser::token::TOK_IMPORT;
+"spawn"		return yy::parser::token::TOK_SPAWN;
+"yield"		return yy::parser::token::TOK_YIELD;
+"join"		return yy::parser::token::TOK_JOIN;
 "{"		return yy::parser::token::TOK_LBRACE;
 "}"		return yy::parser::token::TOK_RBRACE;
 "("		return yy::parser::token::TOK_LPAR;
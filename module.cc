@@ -0,0 +1,779 @@
+#include "driver.hh"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <random>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+namespace AST {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr char magic[] = "PCLC";
+// bumped whenever the grammar or the binary form of the tree changes
+constexpr std::size_t version = 3;
+
+std::string hash(const std::string &text) {
+	// FNV-1a
+	std::uint64_t res = 14695981039346656037ull;
+	for (unsigned char c : text) {
+		res ^= c;
+		res *= 1099511628211ull;
+	}
+	std::ostringstream os;
+	os << std::hex << res;
+	return os.str();
+}
+
+// size and time of the last change of a file, empty when there is none
+std::string stamp(const std::string &path) {
+	std::error_code ec;
+	auto size = fs::file_size(path, ec);
+	if (ec)
+		return {};
+	auto time = fs::last_write_time(path, ec);
+	if (ec)
+		return {};
+	return std::to_string(size) + ' ' + std::to_string(time.time_since_epoch().count());
+}
+
+// other processes either see the whole file or none of it
+void save(const fs::path &file, const std::string &contents) {
+	std::error_code ec;
+	fs::create_directories(file.parent_path(), ec);
+	auto tmp = file;
+	tmp += "." + std::to_string(std::random_device{}());
+	{
+		std::ofstream os{tmp, std::ios::binary};
+		if (!os.write(contents.data(), contents.size()))
+			return (void)fs::remove(tmp, ec);
+	}
+	fs::rename(tmp, file, ec);
+	if (ec)
+		fs::remove(tmp, ec);
+}
+
+template <typename T>
+Expr *make_bin_op(LocT loc, Expr *lhs, Expr *rhs) {
+	return new ExprBinOp<T>{loc, lhs, rhs};
+}
+
+template <typename T>
+Expr *make_un_op(LocT loc, Expr *rhs) {
+	return new ExprUnOp<T>{loc, rhs};
+}
+
+const std::map<std::string, Expr *(*)(LocT, Expr *, Expr *)> bin_ops{
+	{BinOpMul::name,	make_bin_op<BinOpMul>},
+	{BinOpDiv::name,	make_bin_op<BinOpDiv>},
+	{BinOpMod::name,	make_bin_op<BinOpMod>},
+	{BinOpPlus::name,	make_bin_op<BinOpPlus>},
+	{BinOpMinus::name,	make_bin_op<BinOpMinus>},
+	{BinOpLess::name,	make_bin_op<BinOpLess>},
+	{BinOpGrtr::name,	make_bin_op<BinOpGrtr>},
+	{BinOpLessOrEq::name,	make_bin_op<BinOpLessOrEq>},
+	{BinOpGrtrOrEq::name,	make_bin_op<BinOpGrtrOrEq>},
+	{BinOpEqual::name,	make_bin_op<BinOpEqual>},
+	{BinOpNotEqual::name,	make_bin_op<BinOpNotEqual>},
+	{BinOpAnd::name,	make_bin_op<BinOpAnd>},
+	{BinOpOr::name,		make_bin_op<BinOpOr>},
+};
+
+const std::map<std::string, Expr *(*)(LocT, Expr *)> un_ops{
+	{UnOpPlus::name,	make_un_op<UnOpPlus>},
+	{UnOpMinus::name,	make_un_op<UnOpMinus>},
+	{UnOpNot::name,		make_un_op<UnOpNot>},
+	{UnOpPrint::name,	make_un_op<UnOpPrint>},
+};
+
+template <typename T>
+const T intrinsic{};
+
+const Intrinsic *const intrinsics[] = {
+	&intrinsic<IntrinsicUnOp<UnOpAbs>>,
+	&intrinsic<IntrinsicUnOp<UnOpSqrt>>,
+	&intrinsic<IntrinsicBinOp<BinOpMin>>,
+	&intrinsic<IntrinsicBinOp<BinOpMax>>,
+	&intrinsic<IntrinsicBinOp<BinOpGcd>>,
+	&intrinsic<IntrinsicBinOp<BinOpPow>>,
+	&intrinsic<IntrinsicUnOp<UnOpBitNot>>,
+	&intrinsic<IntrinsicBinOp<BinOpBitAnd>>,
+	&intrinsic<IntrinsicBinOp<BinOpBitOr>>,
+	&intrinsic<IntrinsicBinOp<BinOpBitXor>>,
+	&intrinsic<IntrinsicBinOp<BinOpShl>>,
+	&intrinsic<IntrinsicBinOp<BinOpShr>>,
+};
+}
+
+Module::~Module() = default;
+
+ExprFunc *Module::func(const std::string &name) {
+	auto slot = funcs.find(name);
+	if (slot != funcs.end())
+		return slot->second;
+	ExprFunc *res;
+	try {
+		res = lookup(name);
+	} catch (const std::exception &) {
+		Modules::instance().reload(*this);
+		res = lookup(name);
+	}
+	return funcs[name] = res;
+}
+
+ExprFunc *Module::lookup(const std::string &name) {
+	std::size_t lo = 0;
+	std::size_t hi = count;
+	while (lo < hi) {
+		auto mid = lo + (hi - lo) / 2;
+		if (this->name(mid) < name)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	bool own = lo < count && this->name(lo) == name;
+	// the last definition in the file, unless a later import brings another
+	for (auto it = imports.rbegin(), end = imports.rend(); it != end; ++it) {
+		if (own && it->first <= word(lo, 2))
+			break;
+		if (auto res = it->second->func(name))
+			return res;
+	}
+	return own ? read(lo) : nullptr;
+}
+
+Reader Module::at(std::size_t pos) {
+	image->clear();
+	image->seekg(pos);
+	return {*image, &path, fs::path{path}.parent_path().string()};
+}
+
+std::size_t Module::word(std::size_t entry, std::size_t field) {
+	return at(table + (3 * entry + field) * sizeof(std::size_t)).size();
+}
+
+std::string Module::name(std::size_t entry) {
+	return at(data + word(entry, 0)).str();
+}
+
+ExprFunc *Module::read(std::size_t entry) {
+	auto pos = word(entry, 1);
+	std::unique_ptr<Expr> expr{at(data + pos).expr()};
+	auto res = dynamic_cast<ExprFunc *>(expr.get());
+	if (!res || !res->named(name(entry)))
+		throw std::runtime_error("bad function");
+	expr.release();
+	bodies.emplace_back(res);
+	return res;
+}
+
+std::vector<ExprFunc *> Module::loaded() const {
+	std::vector<ExprFunc *> res;
+	for (auto &&[name, func] : funcs)
+		if (func)
+			res.push_back(func);
+	std::sort(res.begin(), res.end(), [](auto &&lhs, auto &&rhs) {
+		return lhs->name() < rhs->name();
+	});
+	return res;
+}
+
+std::vector<ExprFunc *> Module::all() {
+	std::set<std::string> names;
+	for (std::size_t i = 0; i < count; ++i)
+		names.emplace(name(i));
+	for (auto &&[order, module] : imports)
+		for (auto &&func : module->all())
+			names.insert(func->name());
+	for (auto &&[name, func] : funcs)
+		if (func)
+			names.insert(name);
+	std::vector<ExprFunc *> res;
+	for (auto &&name : names)
+		res.push_back(func(name));
+	return res;
+}
+
+std::unique_ptr<Module> Module::host(const std::vector<Native> &natives) {
+	auto module = std::make_unique<Module>();
+	module->path = "host";
+	LocT loc;
+	Expr *blocks = new Empty{loc};
+	for (auto &&native : natives) {
+		std::vector<std::string> params;
+		auto decls = new DeclList;
+		for (std::size_t i = 0; i < native.arity; ++i) {
+			// not an identifier, the parameters never shadow a global
+			params.push_back(std::to_string(i));
+			decls->push_back(std::to_string(i));
+		}
+		auto body = new Scope{loc, new ExprNative{loc, &native, std::move(params)}};
+		auto func = new ExprFunc{loc, body, decls, new ExprId{loc, native.name}};
+		blocks = new Seq{loc, blocks, func};
+		module->funcs[native.name] = func;
+	}
+	module->root.reset(blocks);
+	module->loading = false;
+	return module;
+}
+
+Module &Module::intrinsics() {
+	static auto module = [] {
+		auto module = std::make_unique<Module>();
+		module->path = "intrinsics";
+		LocT loc{&module->path};
+		Expr *blocks = new Empty{loc};
+		for (auto &&entry : AST::intrinsics) {
+			auto decls = new DeclList;
+			for (std::size_t i = 0; i < entry->arity(); ++i)
+				decls->push_back(std::to_string(i));
+			auto body = new Scope{loc, entry->body(loc)};
+			auto func = new ExprFunc{loc, body, decls, new ExprId{loc, entry->name()}};
+			func->intrinsic_ = entry;
+			blocks = new Seq{loc, blocks, func};
+			module->funcs[entry->name()] = func;
+		}
+		module->root.reset(blocks);
+		module->loading = false;
+		module->builtin = true;
+		return module;
+	}();
+	return *module;
+}
+
+Modules &Modules::instance() {
+	static Modules modules;
+	return modules;
+}
+
+Module *Modules::load(const std::string &name, const std::string &dir) {
+	auto path = find(name, dir);
+	if (path.empty())
+		throw std::runtime_error("module '" + name + "' is not found");
+	auto &&slot = loaded[path];
+	if (slot) {
+		if (slot->loading)
+			throw std::runtime_error("module '" + name + "' imports itself");
+		return slot.get();
+	}
+	slot = std::make_unique<Module>();
+	auto module = slot.get();
+	module->path = path;
+	try {
+		auto cache = cache_dir();
+		auto hash = cache.empty() ? std::string{} : known(cache, path);
+		if (hash.empty() || !restore(*module, cache, hash))
+			parse(*module, cache, true);
+	} catch (const std::runtime_error &) {
+		loaded.erase(path);
+		throw;
+	}
+	module->loading = false;
+	return module;
+}
+
+void Modules::reload(Module &module) {
+	module.loading = true;
+	parse(module, cache_dir(), false);
+	module.loading = false;
+}
+
+std::string Modules::find(const std::string &name, const std::string &dir) {
+	std::vector<std::string> dirs{dir};
+	if (auto path = std::getenv("PARACL_PATH")) {
+		std::istringstream is{path};
+		for (std::string entry; std::getline(is, entry, ':');)
+			if (!entry.empty())
+				dirs.push_back(entry);
+	}
+	std::error_code ec;
+	for (auto &&entry : dirs) {
+		auto file = fs::path{entry} / (name + ".pc");
+		if (fs::is_regular_file(file, ec))
+			return fs::canonical(file, ec).string();
+	}
+	return {};
+}
+
+std::string Modules::cache_dir() {
+	if (auto dir = std::getenv("PARACL_CACHE"))
+		return dir;
+	if (auto dir = std::getenv("XDG_CACHE_HOME"))
+		return (fs::path{dir} / "paracl").string();
+	if (auto dir = std::getenv("HOME"))
+		return (fs::path{dir} / ".cache" / "paracl").string();
+	return {};
+}
+
+std::string Modules::known(const std::string &cache, const std::string &path) {
+	std::ifstream is{fs::path{cache} / (hash(path) + ".pcs"), std::ios::binary};
+	if (!is)
+		return {};
+	Reader in{is, nullptr, {}};
+	try {
+		char head[sizeof magic];
+		is.read(head, sizeof head);
+		if (std::string{head, sizeof head} != std::string{magic, sizeof magic}
+				|| in.size() != version || in.str() != path || in.str() != stamp(path))
+			return {};
+		return in.str();
+	} catch (const std::exception &) {
+		return {};
+	}
+}
+
+void Modules::remember(const std::string &cache, const std::string &path,
+		const std::string &stamp, const std::string &hash) {
+	if (stamp.empty())
+		return;
+	std::ostringstream os;
+	Writer out{os};
+	os.write(magic, sizeof magic);
+	out.put(version);
+	out.put(path);
+	out.put(stamp);
+	out.put(hash);
+	save(fs::path{cache} / (AST::hash(path) + ".pcs"), os.str());
+}
+
+void Modules::parse(Module &module, const std::string &cache, bool reuse) {
+	// taken first, a change made while the file is read is seen next time
+	auto time = stamp(module.path);
+	std::ifstream file{module.path, std::ios::binary};
+	std::string text{std::istreambuf_iterator<char>{file}, {}};
+	auto key = hash(text);
+	if (!cache.empty() && reuse && restore(module, cache, key))
+		return remember(cache, module.path, time, key);
+	std::istringstream is{text};
+	yy::Driver driver{&is, fs::path{module.path}.parent_path().string(), &module.path};
+	driver.intrinsics = false;
+	std::unique_ptr<Expr> root{static_cast<Expr *>(driver.parse())};
+	if (!root || driver.errors)
+		throw std::runtime_error("module '" + fs::path{module.path}.stem().string() + "' has errors");
+	auto image = build(*root, key);
+	if (!cache.empty()) {
+		save(fs::path{cache} / (key + ".pcc"), image);
+		remember(cache, module.path, time, key);
+	}
+	module.image = std::make_unique<std::istringstream>(std::move(image));
+	open(module, key);
+}
+
+bool Modules::restore(Module &module, const std::string &cache, const std::string &hash) {
+	auto file = fs::path{cache} / (hash + ".pcc");
+	auto is = std::make_unique<std::ifstream>(file, std::ios::binary);
+	if (!*is)
+		return false;
+	try {
+		// kept open, a newer entry renamed over it does not change what is read
+		module.image = std::move(is);
+		open(module, hash);
+		return true;
+	} catch (const std::exception &) {
+		// a broken entry is parsed again and overwritten
+		std::error_code ec;
+		fs::remove(file, ec);
+		return false;
+	}
+}
+
+std::string Modules::build(const Expr &root, const std::string &hash) {
+	Inliner::Info info;
+	root.scan(info);
+	// the last definition of a name is the one an import gives
+	std::map<std::string, std::size_t> last;
+	for (std::size_t i = 0; i < info.defines.size(); ++i)
+		last[info.defines[i]->name()] = i;
+	std::ostringstream os;
+	std::ostringstream data;
+	Writer out{os};
+	Writer body{data};
+	os.write(magic, sizeof magic);
+	out.put(version);
+	out.put(hash);
+	out.put(info.imports.size());
+	for (auto &&[order, name] : info.imports) {
+		out.put(order);
+		out.put(name);
+	}
+	out.put(last.size());
+	for (auto &&[name, order] : last) {
+		out.put(static_cast<std::size_t>(data.tellp()));
+		body.put(name);
+		out.put(static_cast<std::size_t>(data.tellp()));
+		info.defines[order]->save(body);
+		out.put(order);
+	}
+	return os.str() + data.str();
+}
+
+void Modules::open(Module &module, const std::string &hash) {
+	auto in = module.at(0);
+	char head[sizeof magic];
+	in.is.read(head, sizeof head);
+	if (std::string{head, sizeof head} != std::string{magic, sizeof magic}
+			|| in.size() != version || in.str() != hash)
+		throw std::runtime_error("stale cache");
+	auto dir = fs::path{module.path}.parent_path().string();
+	module.imports.clear();
+	for (auto count = in.size(); count; --count) {
+		auto order = in.size();
+		module.imports.emplace_back(order, load(in.str(), dir));
+	}
+	module.count = in.size();
+	module.table = in.is.tellg();
+	in.is.seekg(0, std::ios::end);
+	std::size_t size = in.is.tellg();
+	if (!in.is || module.count > (size - module.table) / (3 * sizeof(std::size_t)))
+		throw std::runtime_error("truncated");
+	module.data = module.table + 3 * sizeof(std::size_t) * module.count;
+	// functions read from the previous image stay, the others come from this one
+	for (auto it = module.funcs.begin(); it != module.funcs.end();)
+		it = it->second ? std::next(it) : module.funcs.erase(it);
+}
+
+void Writer::put(Tag tag) {
+	os.put(static_cast<char>(tag));
+}
+
+void Writer::put(std::size_t val) {
+	os.write(reinterpret_cast<const char *>(&val), sizeof val);
+}
+
+void Writer::put(int val) {
+	os.write(reinterpret_cast<const char *>(&val), sizeof val);
+}
+
+void Writer::put(double val) {
+	os.write(reinterpret_cast<const char *>(&val), sizeof val);
+}
+
+void Writer::put(const std::string &str) {
+	put(str.size());
+	os.write(str.data(), str.size());
+}
+
+void Writer::put(const yy::location &loc) {
+	put(static_cast<int>(loc.begin.line));
+	put(static_cast<int>(loc.begin.column));
+	put(static_cast<int>(loc.end.line));
+	put(static_cast<int>(loc.end.column));
+}
+
+Tag Reader::tag() {
+	auto res = is.get();
+	if (res < 0 || res > static_cast<int>(Tag::Join))
+		throw std::runtime_error("bad tag");
+	return static_cast<Tag>(res);
+}
+
+std::size_t Reader::size() {
+	std::size_t res;
+	if (!is.read(reinterpret_cast<char *>(&res), sizeof res))
+		throw std::runtime_error("truncated");
+	return res;
+}
+
+int Reader::integer() {
+	int res;
+	if (!is.read(reinterpret_cast<char *>(&res), sizeof res))
+		throw std::runtime_error("truncated");
+	return res;
+}
+
+double Reader::real() {
+	double res;
+	if (!is.read(reinterpret_cast<char *>(&res), sizeof res))
+		throw std::runtime_error("truncated");
+	return res;
+}
+
+std::string Reader::str() {
+	std::string res(size(), '\0');
+	if (!is.read(res.data(), res.size()))
+		throw std::runtime_error("truncated");
+	return res;
+}
+
+yy::location Reader::loc() {
+	yy::location res;
+	res.initialize(file);
+	res.begin.line = integer();
+	res.begin.column = integer();
+	res.end.filename = file;
+	res.end.line = integer();
+	res.end.column = integer();
+	return res;
+}
+
+Expr *Reader::expr() {
+	// nodes are owned by the caller as soon as they are read
+	switch (tag()) {
+	case Tag::Empty:
+		return new Empty{loc()};
+	case Tag::Scope: {
+		auto where = loc();
+		return new Scope{where, expr()};
+	}
+	case Tag::Seq: {
+		auto count = size();
+		std::unique_ptr<Expr> res{expr()};
+		for (std::size_t i = 0; i < count; ++i) {
+			auto where = loc();
+			std::unique_ptr<Expr> snd{expr()};
+			res.reset(new Seq{where, res.release(), snd.release()});
+		}
+		return res.release();
+	}
+	case Tag::While: {
+		auto where = loc();
+		std::unique_ptr<Expr> cond{expr()};
+		std::unique_ptr<Expr> block{expr()};
+		return new While{where, cond.release(), block.release()};
+	}
+	case Tag::If: {
+		auto where = loc();
+		std::unique_ptr<Expr> cond{expr()};
+		std::unique_ptr<Expr> true_block{expr()};
+		std::unique_ptr<Expr> false_block{size() ? expr() : nullptr};
+		return new If{where, cond.release(), true_block.release(), false_block.release()};
+	}
+	case Tag::Return: {
+		auto where = loc();
+		return new Return{where, expr()};
+	}
+	case Tag::Int: {
+		auto where = loc();
+		return new ExprInt{where, integer()};
+	}
+	case Tag::Float: {
+		auto where = loc();
+		return new ExprFloat{where, real()};
+	}
+	case Tag::Id: {
+		auto where = loc();
+		return new ExprId{where, str()};
+	}
+	case Tag::List: {
+		auto count = size();
+		std::unique_ptr<ExprList> res;
+		for (std::size_t i = 0; i < count; ++i) {
+			auto where = loc();
+			std::unique_ptr<Expr> head{expr()};
+			res.reset(new ExprList{where, res.release(), head.release()});
+		}
+		return res.release();
+	}
+	case Tag::Func: {
+		auto where = loc();
+		auto decls = std::make_unique<DeclList>();
+		for (auto count = size(); count; --count)
+			decls->push_back(str());
+		std::unique_ptr<Expr> id{size() ? expr() : nullptr};
+		std::unique_ptr<Expr> body{expr()};
+		if (!dynamic_cast<Scope *>(body.get()) || (id && !dynamic_cast<ExprId *>(id.get())))
+			throw std::runtime_error("bad function");
+		return new ExprFunc{where, body.release(), decls.release(), id.release()};
+	}
+	case Tag::Qmark:
+		return new ExprQmark{loc()};
+	case Tag::Assign: {
+		auto where = loc();
+		std::unique_ptr<Expr> id{expr()};
+		std::unique_ptr<Expr> val{expr()};
+		if (!dynamic_cast<ExprId *>(id.get()))
+			throw std::runtime_error("bad assignment");
+		return new ExprAssign{where, id.release(), val.release()};
+	}
+	case Tag::Apply: {
+		auto where = loc();
+		std::unique_ptr<Expr> id{expr()};
+		std::unique_ptr<Expr> ops{size() ? expr() : nullptr};
+		if (!dynamic_cast<ExprId *>(id.get()) || (ops && !dynamic_cast<ExprList *>(ops.get())))
+			throw std::runtime_error("bad call");
+		return new ExprApply{where, id.release(), ops.release()};
+	}
+	case Tag::BinOp: {
+		auto op = bin_ops.find(str());
+		if (op == bin_ops.end())
+			throw std::runtime_error("bad operator");
+		auto where = loc();
+		std::unique_ptr<Expr> lhs{expr()};
+		std::unique_ptr<Expr> rhs{expr()};
+		return op->second(where, lhs.release(), rhs.release());
+	}
+	case Tag::UnOp: {
+		auto op = un_ops.find(str());
+		if (op == un_ops.end())
+			throw std::runtime_error("bad operator");
+		auto where = loc();
+		return op->second(where, expr());
+	}
+	case Tag::Spawn: {
+		auto where = loc();
+		std::unique_ptr<Expr> id{expr()};
+		std::unique_ptr<Expr> ops{size() ? expr() : nullptr};
+		if (!dynamic_cast<ExprId *>(id.get()) || (ops && !dynamic_cast<ExprList *>(ops.get())))
+			throw std::runtime_error("bad spawn");
+		return new Spawn{where, id.release(), ops.release()};
+	}
+	case Tag::Yield:
+		return new Yield{loc()};
+	case Tag::Join: {
+		auto where = loc();
+		return new Join{where, expr()};
+	}
+	case Tag::Import: {
+		auto where = loc();
+		auto name = str();
+		return new Import{where, name, Modules::instance().load(name, dir)};
+	}
+	}
+	throw std::runtime_error("bad tag");
+}
+
+void Empty::save(Writer &out) const {
+	out.put(Tag::Empty);
+	out.put(loc_);
+}
+
+void Scope::save(Writer &out) const {
+	out.put(Tag::Scope);
+	out.put(loc_);
+	blocks_->save(out);
+}
+
+void Seq::save(Writer &out) const {
+	auto seqs = chain(this);
+	out.put(Tag::Seq);
+	out.put(seqs.size());
+	seqs.back()->fst_->save(out);
+	for (auto it = seqs.rbegin(), end = seqs.rend(); it != end; ++it) {
+		out.put((*it)->loc_);
+		(*it)->snd_->save(out);
+	}
+}
+
+void While::save(Writer &out) const {
+	out.put(Tag::While);
+	out.put(loc_);
+	expr_->save(out);
+	block_->save(out);
+}
+
+void If::save(Writer &out) const {
+	out.put(Tag::If);
+	out.put(loc_);
+	expr_->save(out);
+	true_block_->save(out);
+	out.put(std::size_t{false_block_ != nullptr});
+	if (false_block_)
+		false_block_->save(out);
+}
+
+void Return::save(Writer &out) const {
+	out.put(Tag::Return);
+	out.put(loc_);
+	expr_->save(out);
+}
+
+void ExprInt::save(Writer &out) const {
+	out.put(Tag::Int);
+	out.put(loc_);
+	out.put(val_);
+}
+
+void ExprFloat::save(Writer &out) const {
+	out.put(Tag::Float);
+	out.put(loc_);
+	out.put(val_);
+}
+
+void ExprId::save(Writer &out) const {
+	out.put(Tag::Id);
+	out.put(loc_);
+	out.put(name_);
+}
+
+void ExprList::save(Writer &out) const {
+	std::vector<const ExprList *> lists;
+	for (auto list = this; list; list = list->tail_.get())
+		lists.push_back(list);
+	out.put(Tag::List);
+	out.put(lists.size());
+	for (auto it = lists.rbegin(), end = lists.rend(); it != end; ++it) {
+		out.put((*it)->loc_);
+		(*it)->head_->save(out);
+	}
+}
+
+void ExprFunc::save(Writer &out) const {
+	out.put(Tag::Func);
+	out.put(loc_);
+	out.put(decls_->size());
+	for (auto it = decls_->cbegin(), end = decls_->cend(); it != end; ++it)
+		out.put(*it);
+	out.put(std::size_t{id_ != nullptr});
+	if (id_)
+		id_->save(out);
+	body_->save(out);
+}
+
+void ExprQmark::save(Writer &out) const {
+	out.put(Tag::Qmark);
+	out.put(loc_);
+}
+
+void ExprAssign::save(Writer &out) const {
+	out.put(Tag::Assign);
+	out.put(loc_);
+	id_->save(out);
+	expr_->save(out);
+}
+
+void ExprApply::save(Writer &out) const {
+	out.put(Tag::Apply);
+	out.put(loc_);
+	id_->save(out);
+	out.put(std::size_t{ops_ != nullptr});
+	if (ops_)
+		ops_->save(out);
+}
+
+void Import::save(Writer &out) const {
+	out.put(Tag::Import);
+	out.put(loc_);
+	out.put(name_);
+}
+
+void ExprNative::save(Writer &out) const {
+	throw std::logic_error("host functions cannot be saved");
+}
+
+void Spawn::save(Writer &out) const {
+	out.put(Tag::Spawn);
+	out.put(loc_);
+	id_->save(out);
+	out.put(std::size_t{ops_ != nullptr});
+	if (ops_)
+		ops_->save(out);
+}
+
+void Yield::save(Writer &out) const {
+	out.put(Tag::Yield);
+	out.put(loc_);
+}
+
+void Join::save(Writer &out) const {
+	out.put(Tag::Join);
+	out.put(loc_);
+	expr_->save(out);
+}
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include "location.hh"
+#include "host.hh"
+#include <istream>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace AST {
+
+struct Expr;
+struct ExprFunc;
+struct Reader;
+
+// A .pc file, the named functions defined at its top level are what an
+// import brings into the globals. A file is kept in its binary form and
+// each function is only read when a program first looks it up.
+struct Module {
+	std::string path;
+	// the functions of the host and builtin modules, which are not read
+	std::unique_ptr<Expr> root;
+	bool loading = true;
+	// its functions are builtins, a variable of the same name hides them
+	bool builtin = false;
+	~Module();
+	// the function an import defines under the name, null when there is none
+	ExprFunc *func(const std::string &name);
+	// the functions looked up so far, the only ones a program may call
+	std::vector<ExprFunc *> loaded() const;
+	// every function, they are all read
+	std::vector<ExprFunc *> all();
+	// functions of a host program calling its natives, they must outlive it
+	static std::unique_ptr<Module> host(const std::vector<Native> &natives);
+	// functions every program starts with, see Intrinsic
+	static Module &intrinsics();
+private:
+	friend struct Modules;
+	// header, imports, table of the functions sorted by name, their names
+	// and bodies; only the parts a lookup needs are read
+	std::unique_ptr<std::istream> image;
+	std::size_t count = 0;
+	std::size_t table = 0;
+	std::size_t data = 0;
+	// modules imported at the top level after as many functions are defined
+	std::vector<std::pair<std::size_t, Module *>> imports;
+	// by name, null for the names looked up and not defined
+	std::unordered_map<std::string, ExprFunc *> funcs;
+	std::vector<std::unique_ptr<ExprFunc>> bodies;
+	ExprFunc *lookup(const std::string &name);
+	Reader at(std::size_t pos);
+	std::size_t word(std::size_t entry, std::size_t field);
+	std::string name(std::size_t entry);
+	ExprFunc *read(std::size_t entry);
+};
+
+// Loads modules once per process, their binary forms are also kept on disk
+// in $PARACL_CACHE (~/.cache/paracl by default) under the hash of the source
+struct Modules {
+	std::map<std::string, std::unique_ptr<Module>> loaded;
+
+	static Modules &instance();
+	Module *load(const std::string &name, const std::string &dir);
+	// parses the source again when its cache entry turns out to be broken
+	void reload(Module &module);
+private:
+	static std::string find(const std::string &name, const std::string &dir);
+	static std::string cache_dir();
+	// hash of the source, known without reading it while its size and time stay
+	static std::string known(const std::string &cache, const std::string &path);
+	static void remember(const std::string &cache, const std::string &path,
+		const std::string &stamp, const std::string &hash);
+	void parse(Module &module, const std::string &cache, bool reuse);
+	bool restore(Module &module, const std::string &cache, const std::string &hash);
+	static std::string build(const Expr &root, const std::string &hash);
+	void open(Module &module, const std::string &hash);
+};
+
+// Binary form of the tree used by the on-disk cache
+enum class Tag : unsigned char {
+	Empty, Scope, Seq, While, If, Return, Int, Float, Id, List,
+	Func, Qmark, Assign, Apply, BinOp, UnOp, Import, Spawn, Yield, Join
+};
+
+struct Writer {
+	std::ostream &os;
+	void put(Tag tag);
+	void put(std::size_t val);
+	void put(int val);
+	void put(double val);
+	void put(const std::string &str);
+	void put(const yy::location &loc);
+};
+
+struct Reader {
+	std::istream &is;
+	const std::string *file;
+	std::string dir;
+	Tag tag();
+	std::size_t size();
+	int integer();
+	double real();
+	std::string str();
+	yy::location loc();
+	Expr *expr();
+};
+}
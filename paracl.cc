@@ -0,0 +1,138 @@
+#include "paracl.hh"
+#include "driver.hh"
+#include <sstream>
+#include <utility>
+
+namespace paracl {
+
+struct Program::Impl {
+	std::vector<Native> natives;
+	std::unique_ptr<AST::Module> host;
+	std::unique_ptr<AST::Scope> root;
+	AST::Code code;
+};
+
+Program::Program(std::istream &src, std::vector<Native> natives, const std::string &dir) :
+	impl_(std::make_unique<Impl>())
+{
+	yy::Driver driver{&src, dir};
+	if (!natives.empty()) {
+		impl_->natives = std::move(natives);
+		impl_->host = AST::Module::host(impl_->natives);
+		driver.host = impl_->host.get();
+	}
+	auto root = driver.parse();
+	impl_->root.reset(static_cast<AST::Scope *>(root));
+	if (!root || driver.errors)
+		throw Error("Program has syntax errors");
+	AST::infer(root, true);
+	if (AST::inline_calls(root, 32))
+		AST::infer(root, true);
+	AST::bind_calls(root);
+	try {
+		// the blocks run in the globals of a context instead of a new scope
+		impl_->code = impl_->root->blocks()->compile();
+	} catch (const AST::Context::Suspends &) {
+		throw Error("Coroutines cannot run in a host program");
+	}
+}
+
+Program::Program(Program &&rhs) noexcept = default;
+Program &Program::operator = (Program &&rhs) noexcept = default;
+Program::~Program() = default;
+
+struct Context::Impl {
+	const Program::Impl &prog;
+	IO io;
+	AST::Context ctxt;
+	// the functions are only checked against the globals of a whole run
+	bool ran = false;
+
+	Impl(const Program::Impl &p, IO i) : prog(p), io(std::move(i)) {
+		ctxt.io = &io;
+		ctxt.scope_stack.emplace_back();
+		ctxt.call_stack.emplace_back();
+	}
+	// drops what a failed run left on the stacks, the globals stay
+	void reset() {
+		ctxt.scope_stack.resize(1);
+		ctxt.call_stack.resize(1);
+		ctxt.ctxts_stack.clear();
+		ctxt.res.clear();
+		ctxt.returning = false;
+		ctxt.depth = 0;
+		ctxt.frame = 1;
+	}
+	template <typename F>
+	void guard(F run) {
+		try {
+			run();
+		} catch (const AST::Values::ValueExcept &err) {
+			std::ostringstream os;
+			os << "Type error: " << err;
+			if (ctxt.fault)
+				os << " is used at " << ctxt.fault->loc_;
+			fail(os.str());
+		} catch (const std::logic_error &err) {
+			fail(std::string{"Semantic error: "} + err.what());
+		} catch (const std::bad_alloc &ba) {
+			fail(std::string{"Context is too large: "} + ba.what());
+		}
+	}
+	[[noreturn]] void fail(const std::string &msg) {
+		reset();
+		throw Error(msg);
+	}
+};
+
+Context::Context(const Program &prog, IO io) :
+	impl_(std::make_unique<Impl>(*prog.impl_, std::move(io)))
+{}
+
+Context::Context(Context &&rhs) noexcept = default;
+Context &Context::operator = (Context &&rhs) noexcept = default;
+Context::~Context() = default;
+
+void Context::run() {
+	auto &&ctxt = impl_->ctxt;
+	impl_->reset();
+	ctxt.scope_stack.front().clear();
+	ctxt.imports.clear();
+	impl_->ran = false;
+	impl_->guard([&] {
+		try {
+			impl_->prog.code(ctxt);
+		} catch (const AST::Context::Unwind &) {
+		}
+	});
+	ctxt.returning = false;
+	impl_->ran = true;
+}
+
+std::optional<Number> Context::invoke(const std::string &name, const Number *args, std::size_t count) {
+	auto &&ctxt = impl_->ctxt;
+	if (!impl_->ran)
+		throw Error("Semantic error: the program has not run to its end");
+	auto var = ctxt.lookup(name);
+	if (!var || !var->isSameType<AST::Func>())
+		throw Error("Semantic error: " + name + " is not a function");
+	auto func = var->get<AST::Func>();
+	if (func.decls_->size() != count)
+		throw Error("Semantic error: Incorrect number of arguments");
+	auto &&params = ctxt.scope_stack.emplace_back();
+	auto decl = func.decls_->cbegin();
+	for (std::size_t i = 0; i < count; ++i, ++decl)
+		std::visit([&](auto val) {
+			params.emplace(*decl, AST::Value{func.body_->loc_, val});
+		}, args[i]);
+	AST::Value res;
+	impl_->guard([&] {
+		res = AST::ExprApply::call(ctxt, func);
+	});
+	if (res.isSameType<int>())
+		return res.get<int>();
+	if (res.isSameType<double>())
+		return res.get<double>();
+	return std::nullopt;
+}
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include "host.hh"
+#include <cstddef>
+#include <istream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Interface of the paracl library for programs embedding the interpreter.
+// A program is parsed, checked and compiled once, then any number of
+// contexts run it and call its functions.
+namespace paracl {
+
+using Number = AST::Number;
+using Native = AST::Native;
+using IO = AST::IO;
+
+// Syntax errors of a program and the errors of running it, with the
+// messages the driver prints
+struct Error : std::runtime_error {
+	using std::runtime_error::runtime_error;
+};
+
+class Program {
+public:
+	// natives are globals of the program from its start, imports are looked
+	// up in dir
+	explicit Program(std::istream &src, std::vector<Native> natives = {},
+		const std::string &dir = ".");
+	Program(Program &&rhs) noexcept;
+	Program &operator = (Program &&rhs) noexcept;
+	~Program();
+private:
+	friend class Context;
+	struct Impl;
+	std::unique_ptr<Impl> impl_;
+};
+
+// Globals and stacks of one run of a program, the program must outlive it
+class Context {
+public:
+	explicit Context(const Program &prog, IO io = {});
+	Context(Context &&rhs) noexcept;
+	Context &operator = (Context &&rhs) noexcept;
+	~Context();
+	// runs the program from the start, that defines its globals
+	void run();
+	// calls a global function after a run that did not fail, nothing when
+	// the function does not give a number
+	std::optional<Number> call(const std::string &name, const std::vector<Number> &args) {
+		return invoke(name, args.data(), args.size());
+	}
+	template <typename... Args>
+	std::optional<Number> call(const std::string &name, Args... args) {
+		const Number argv[sizeof...(Args) + 1] = {Number{args}...};
+		return invoke(name, argv, sizeof...(Args));
+	}
+private:
+	struct Impl;
+	std::unique_ptr<Impl> impl_;
+	std::optional<Number> invoke(const std::string &name, const Number *args, std::size_t count);
+};
+}
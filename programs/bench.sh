@@ -0,0 +1,64 @@
+#!/bin/bash
+# Times every program under each execution engine: bench.sh [runs] [options...]
+blue='\033[34m'
+nc='\033[0m'
+driver='../build/driver.out'
+host='../build/host.out'
+runs=${1:-20}
+shift
+# calls looked up by name on every call are timed with --no-bind, the walker
+# without its traces with --no-trace
+engines=('' '--no-bind' '--walker' '--walker --no-bind' '--walker --no-trace')
+
+for prog in $(ls | grep .pc)
+do
+	name=${prog%.*}
+	inputs=$(ls | grep '^'$name"_[[:digit:]]\+.dat")
+	for data in ${inputs:-/dev/null}
+	do
+		echo -e "$blue $name $nc< $data:"
+		for engine in "${engines[@]}"
+		do
+			start=$(date +%s%N)
+			for ((i = 0; i < runs; ++i))
+			do
+				$driver $engine "$@" $prog < $data > /dev/null
+			done
+			end=$(date +%s%N)
+			printf "\t%-20s %8d us\n" "${engine:-closures}" $(((end - start) / runs / 1000))
+		done
+	done
+done
+# the same call made by a host on a program parsed once, not by a new process
+echo -e "$blue ackermann.pc $nc ack(2, 3) from a host:"
+per_call=$($host --repeat=$((runs * 1000)) ackermann.pc ack 2 3 < ackermann_9.dat 2>&1 > /dev/null)
+printf "\t%-20s %8d ns\n" library $(echo $per_call | awk '{ print $3 }')
+# intrinsics against the same functions written in ParaCL, called n times
+n=20000
+tmp=$(mktemp -d)
+cat > $tmp/lib.pc <<'END'
+abs_pc = func(x) : abs_pc { if (x < 0) return -x; x; }
+min_pc = func(a, b) : min_pc { if (b < a) return b; a; }
+gcd_pc = func(a, b) : gcd_pc { while (b != 0) { t = b; b = a % b; a = t; } a; }
+pow_pc = func(a, b) : pow_pc { r = 1; while (b > 0) { r = r * a; b = b - 1; } r; }
+END
+for call in 'abs(n - 2 * i)' 'min(i, n - i)' 'gcd(i, 360)' 'pow(3, i % 16)'
+do
+	echo "n = $n; i = 0; s = 0; while (i < n) { s = s + $call; i = i + 1; } print s;" > $tmp/intrinsic.pc
+	(cat $tmp/lib.pc; sed 's/\(abs\|min\|gcd\|pow\)(/\1_pc(/' $tmp/intrinsic.pc) > $tmp/script.pc
+	echo -e "$blue $call $nc x $n:"
+	for engine in "${engines[@]}"
+	do
+		for kind in intrinsic script
+		do
+			start=$(date +%s%N)
+			for ((i = 0; i < runs; ++i))
+			do
+				$driver $engine "$@" $tmp/$kind.pc > /dev/null
+			done
+			end=$(date +%s%N)
+			printf "\t%-20s %-10s %8d us\n" "${engine:-closures}" $kind $(((end - start) / runs / 1000))
+		done
+	done
+done
+rm -rf $tmp
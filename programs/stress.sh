@@ -0,0 +1,137 @@
+#!/bin/bash
+# Runs generated programs of growing size, checks their output and reports
+# time and peak memory: stress.sh [options...]
+red='\033[31m'
+blue='\033[34m'
+nc='\033[0m'
+driver='../build/driver.out'
+time=${TIME:-/usr/bin/time}
+tmp=$(mktemp -d)
+# the modules of the runs are cached here, not in ~/.cache/paracl
+export PARACL_CACHE=$tmp/cache
+
+# statements: x = x + 1; repeated $1 times inside a function and at the top
+statements() {
+	echo 'x = 0;'
+	echo 'f = func(x) : f {'
+	yes 'x = x + 1;' | head -n $1
+	echo 'x; }'
+	yes 'x = x + 1;' | head -n $1
+	echo 'print x;'
+	echo 'print f(0);'
+}
+
+# arguments: a function of $1 parameters applied to as many arguments
+arguments() {
+	echo -n 'f = func('
+	seq -s ', ' -f 'a%g' $1 | tr -d '\n'
+	echo ") : f { a1 - a$1; }"
+	echo -n 'print f('
+	seq -s ', ' $1 | tr -d '\n'
+	echo ');'
+}
+
+# library: a module defining $1 functions
+library() {
+	seq 0 $(($1 - 1)) | awk '{ print "f" $1 " = func(x) : f" $1 " { x + " $1 "; }" }'
+}
+
+# tasks: $1 coroutines yielding $2 times each, joined by their ids 1..$1
+tasks() {
+	echo "work = func(n) : work { i = 0; while (i < $2) { yield; i = i + 1; } 1; }"
+	echo "n = $1; i = 0;"
+	echo 'while (i < n) { spawn work(i); i = i + 1; }'
+	echo 'sum = 0; while (n > 0) { sum = sum + join n; n = n - 1; }'
+	echo 'print sum;'
+}
+
+# loop: a loop of $1 iterations
+loop() {
+	echo "i = 0; while (i < $1) i = i + 1;"
+	echo 'print i;'
+}
+
+# recursion: calls nested $1 deep
+recursion() {
+	echo 'f = func(n) : f { if (n == 0) return 0; return 1 + f(n - 1); }'
+	echo "print f($1);"
+}
+
+# program: an example program reading $1
+program() {
+	sed "s/?/$1/" $prog
+}
+
+run() {
+	echo -e "$blue $1 $2 $nc:"
+	$1 $2 > $tmp/prog.pc
+	$time -f "\t%e s, %M KiB" -o $tmp/usage $driver "${opts[@]}" $tmp/prog.pc > $tmp/log
+	cat $tmp/usage
+	echo -e "${red} $(diff $tmp/log <(echo -e "$3")) ${nc}"
+}
+
+# imports: a program importing a library, parsed first and then read from the cache
+imports() {
+	library $1 > $tmp/lib.pc
+	echo "import lib; print f$(($1 - 1))(1);" > $tmp/prog.pc
+	rm -rf $tmp/cache
+	for cache in cold warm
+	do
+		echo -e "$blue import library $1 $nc($cache cache):"
+		$time -f "\t%e s, %M KiB" -o $tmp/usage $driver "${opts[@]}" $tmp/prog.pc > $tmp/log
+		cat $tmp/usage
+		echo -e "${red} $(diff $tmp/log <(echo $1)) ${nc}"
+	done
+}
+
+opts=("$@")
+for n in 500000 1000000 2000000
+do
+	run statements $n "$n\n$n"
+done
+for n in 1000 5000 20000
+do
+	run arguments $n "$((1 - n))"
+done
+for n in 10000 100000
+do
+	imports $n
+done
+# memory per coroutine, then the cost of switching between them
+for n in "10000 1" "100000 1" "100 10000" "10000 100"
+do
+	run tasks "$n" "${n% *}"
+done
+# the governor, first with limits that are never reached, then with each of them
+for n in 10000000
+do
+	run loop $n "$n"
+	opts=("$@" --max-steps=$((2 * n)) --max-depth=1000 --max-memory=1000000 --timeout=100000)
+	run loop $n "$n"
+	opts=("$@" --max-steps=$((n / 2)))
+	run loop $n "Limit exceeded: more than $((n / 2)) steps"
+	opts=("$@" --timeout=100)
+	run loop $((100 * n)) "Limit exceeded: ran for more than 100 ms"
+	opts=("$@" --slice=1000)
+	run loop $n "$n"
+	opts=("$@")
+done
+for n in 100000
+do
+	opts=("$@" --max-depth=$((n / 2)))
+	run recursion $n "Limit exceeded: calls nested deeper than $((n / 2))"
+	opts=("$@" --max-memory=1000000)
+	run recursion $n "Limit exceeded: stacks take more than 1000000 bytes"
+	opts=("$@")
+done
+# hot loops of the walker, replayed from traces and walked every time
+for engine in --walker '--walker --no-trace'
+do
+	opts=("$@" $engine)
+	prog=fib.pc
+	run program 3000000 768372992
+	prog=gcd_table.pc
+	run program 300 336784
+	opts=("$@")
+done
+rm -rf $tmp
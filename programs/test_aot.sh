@@ -0,0 +1,70 @@
+#!/bin/bash
+# Compiles every program ahead of time and checks that the native binary
+# prints the same as the interpreter and the expected answers
+red='\033[31m'
+blue='\033[34m'
+nc='\033[0m'
+driver='../build/driver.out'
+cxx=${CXX:-c++}
+tmp=$(mktemp -d)
+# programs the back end refuses: coroutines and host functions
+rejected=' coro '
+status=0
+
+# runs the binary and the interpreter on the input $1, both have to print
+# the same, the answer $2 if it exists, report the same errors and exit alike
+check() {
+	$tmp/$name < $1 > $tmp/aot.log 2> $tmp/aot.err
+	echo "exit $?" >> $tmp/aot.err
+	$driver $prog < $1 > $tmp/int.log 2> $tmp/int.err
+	echo "exit $?" >> $tmp/int.err
+	if [ -f $2 ] && ! diff $tmp/aot.log $2
+	then
+		echo -e "${red} output differs from $2 ${nc}"
+		status=1
+	fi
+	if ! diff $tmp/aot.log $tmp/int.log || ! diff $tmp/aot.err $tmp/int.err
+	then
+		echo -e "${red} differs from the interpreter ${nc}"
+		status=1
+	fi
+}
+
+for prog in $(ls | grep .pc)
+do
+	name=${prog%.*}
+	echo -e "$blue $name $nc:"
+	if [[ $rejected == *" $name "* ]]
+	then
+		if $driver --emit-cpp=$tmp/$name.cc $prog
+		then
+			echo -e "${red} expected to be rejected by the C++ back end ${nc}"
+			status=1
+		fi
+		continue
+	fi
+	if ! $driver --emit-cpp=$tmp/$name.cc $prog
+	then
+		echo -e "${red} cannot be emitted as C++ ${nc}"
+		status=1
+		continue
+	fi
+	if ! $cxx -std=c++17 -O2 -o $tmp/$name $tmp/$name.cc
+	then
+		echo -e "${red} emitted C++ does not build ${nc}"
+		status=1
+		continue
+	fi
+	d=0
+	for data in $(ls | grep '^'$name"_[[:digit:]]\+.dat")
+	do
+		echo -e "\t$data"
+		check $data ${data%.*}.ans
+		d=1
+	done
+	if [ $d == 0 ]; then
+		check /dev/null $name.ans
+	fi
+done
+rm -rf $tmp
+exit $status
@@ -0,0 +1,37 @@
+#!/bin/bash
+# Runs programs through the library with the example host, which then
+# calls one of their functions, and checks what it prints
+red='\033[31m'
+blue='\033[34m'
+nc='\033[0m'
+host='../build/host.out'
+tmp=$(mktemp -d)
+
+# check <expected> <input> <host arguments...>
+check() {
+	echo -e "$blue ${@:3} $nc:"
+	$host "${@:3}" < $2 > $tmp/log
+	echo -e "${red} $(diff $tmp/log <(echo -e "$1")) ${nc}"
+}
+
+# functions of the programs, also with the types they are not called with
+check "9\n9" ackermann_9.dat ackermann.pc ack 2 3
+check "189\n6" gcd_table_10.dat gcd_table.pc euqlid 12 18
+check "189\n6" gcd_table_10.dat gcd_table.pc euqlid 12.5 18
+check "0\n832040" fun_fib_0.dat fun_fib.pc fib 30
+cat > $tmp/host.pc <<'PROG'
+print hypot(3, 4);
+twice = func(x) : twice { x * 2; }
+print twice(2);
+norm = func(x, y) : norm { hypot(x, y) + 0; }
+sum = 0;
+add = func(x) : add { sum = sum + x; }
+PROG
+check "5\n4\n3" /dev/null $tmp/host.pc twice 1.5
+check "5\n4\n13" /dev/null $tmp/host.pc norm 5 12
+check "5\n4\n2.5" /dev/null $tmp/host.pc add 2.5
+check "5\n4\nSemantic error: none is not a function" /dev/null $tmp/host.pc none
+check "5\n4\nSemantic error: Incorrect number of arguments" /dev/null $tmp/host.pc twice 1 2
+echo 'f = func(x) : f { yield; }' > $tmp/coro.pc
+check "Coroutines cannot run in a host program" /dev/null $tmp/coro.pc
+rm -rf $tmp
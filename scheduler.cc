@@ -0,0 +1,84 @@
+#include "scheduler.hh"
+#include "governor.hh"
+#include <cassert>
+#include <iostream>
+#include <poll.h>
+#include <stdexcept>
+#include <utility>
+
+namespace AST {
+
+Scheduler::Task &Scheduler::spawn(const Expr *entry) {
+	auto id = last++;
+	auto &&task = tasks[id] = std::make_unique<Task>();
+	task->ctxt.sched = this;
+	if (Tracer::enabled)
+		task->ctxt.tracer = &tracer;
+	if (gov)
+		gov->arm(task->ctxt);
+	task->ctxt.call_stack.emplace_back();
+	task->next = entry;
+	task->id = id;
+	ready.push_back(task.get());
+	return *task;
+}
+
+bool Scheduler::run() {
+	while (!ready.empty()) {
+		current = ready.front();
+		ready.pop_front();
+		auto &&ctxt = current->ctxt;
+		ctxt.countdown = countdown;
+		ctxt.walk(current->next);
+		countdown = ctxt.countdown;
+		if (auto next = std::exchange(ctxt.resume, nullptr)) {
+			current->next = next;
+			if (gov && std::exchange(gov->paused, false)) {
+				// the same task goes on in the next slice
+				ready.push_front(current);
+				return false;
+			}
+			if (!current->blocked)
+				ready.push_back(current);
+		} else
+			finish(current);
+	}
+	if (!tasks.empty())
+		throw std::logic_error("Deadlock, every task is waiting");
+	return true;
+}
+
+void Scheduler::finish(Task *task) {
+	auto &&ctxt = task->ctxt;
+	assert(ctxt.res.size() == 1);
+	assert(ctxt.call_stack.size() == 1);
+	assert(ctxt.ctxts_stack.size() == 0);
+	for (auto &&waiter : task->waiters) {
+		waiter->blocked = false;
+		ready.push_back(waiter);
+	}
+	results.emplace(task->id, std::move(ctxt.res.back()));
+	tasks.erase(task->id);
+}
+
+const Value *Scheduler::result(int id) const {
+	auto res = results.find(id);
+	return res == results.end() ? nullptr : &res->second;
+}
+
+void Scheduler::wait(int id) {
+	auto task = tasks.find(id);
+	if (task == tasks.end())
+		throw std::logic_error("Unknown task " + std::to_string(id));
+	task->second->waiters.push_back(current);
+	current->blocked = true;
+}
+
+bool Scheduler::input_ready() {
+	// a line read earlier may hold more numbers, poll does not see them
+	if (std::cin.rdbuf()->in_avail() > 0)
+		return true;
+	pollfd fd{0, POLLIN, 0};
+	return poll(&fd, 1, 0) != 0;
+}
+}
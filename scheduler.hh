@@ -0,0 +1,46 @@
+#pragma once
+#include "ast.hh"
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace AST {
+
+// Runs the coroutines of a walked program in one thread. A task walks
+// until it yields, waits for another task or for input, then the next
+// ready one continues where it stopped. Tasks start from a copy of the
+// globals of their spawner and only give back their result.
+struct Scheduler {
+	struct Task {
+		Context ctxt;
+		const Expr *next;
+		int id;
+		bool blocked = false;
+		std::vector<Task *> waiters;
+	};
+
+	std::unordered_map<int, std::unique_ptr<Task>> tasks;
+	std::unordered_map<int, Value> results;
+	std::deque<Task *> ready;
+	Task *current = nullptr;
+	int last = 0;
+	// the tasks share one count of steps for the governor
+	Governor *gov = nullptr;
+	std::size_t countdown = -1;
+	Tracer tracer;
+
+	Task &spawn(const Expr *entry);
+	// false when the governor paused the program at the end of a slice
+	bool run();
+	// whether another task could run instead of the current one
+	bool busy() const {
+		return !ready.empty();
+	}
+	const Value *result(int id) const;
+	void wait(int id);
+	static bool input_ready();
+private:
+	void finish(Task *task);
+};
+}
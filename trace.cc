@@ -0,0 +1,318 @@
+#include "ast.hh"
+#include <algorithm>
+
+namespace AST {
+
+bool Tracer::enabled = true;
+bool Tracer::report = false;
+
+void Trace::add(const Context &ctxt, const Expr *node, Op op) {
+	steps.push_back({std::move(op), ctxt.prev, node, 0, nullptr});
+}
+
+int Trace::slot(const Context &ctxt, const std::string &name, bool create) {
+	auto &&scopes = ctxt.scope_stack;
+	auto level = scopes.size();
+	while (level-- > 0 && !scopes[level].count(name));
+	// assignments make variables missing everywhere in the innermost scope
+	if (level == std::size_t(-1)) {
+		// an imported function is assigned in the globals, see Context::import
+		if (!create || ctxt.imported(name))
+			return -1;
+		level = scopes.size() - 1;
+	}
+	if (level >= base)
+		return -1;
+	auto &&outer = loop->outer;
+	auto it = std::find(outer.begin(), outer.end(), name);
+	if (it == outer.end())
+		it = outer.insert(it, name);
+	return it - outer.begin();
+}
+
+unsigned char Trace::type(const Value &val) {
+	if (val.isSameType<int>())
+		return Types::Int;
+	if (val.isSameType<double>())
+		return Types::Double;
+	return Types::None;
+}
+
+void Tracer::record(Context &ctxt, Traces &loop, Trace::Step *anchor, std::size_t base) {
+	loop.pending = std::make_unique<Trace>();
+	loop.pending->loop = &loop;
+	loop.pending->anchor = anchor;
+	loop.pending->base = base;
+	ctxt.recording = loop.pending.get();
+}
+
+void Tracer::finish(Context &ctxt) {
+	auto &&loop = *ctxt.recording->loop;
+	if (auto anchor = ctxt.recording->anchor)
+		anchor->branch = std::move(loop.pending);
+	else
+		loop.root = std::move(loop.pending);
+	ctxt.recording = nullptr;
+	++recorded;
+}
+
+void Tracer::abort(Context &ctxt) {
+	auto &&loop = *ctxt.recording->loop;
+	// a guard keeps its count and is not recorded again
+	if (!ctxt.recording->anchor) {
+		++loop.aborts;
+		loop.hits = 0;
+	}
+	loop.pending.reset();
+	ctxt.recording = nullptr;
+	++aborted;
+}
+
+void Tracer::cancel(Context &ctxt) {
+	ctxt.recording->loop->pending.reset();
+	ctxt.recording = nullptr;
+}
+
+void Tracer::print(std::ostream &os) const {
+	os << "Traces: " << recorded << " recorded, " << aborted << " aborted, "
+		<< executed << " executed" << std::endl;
+	os << "Iterations replayed: " << iterations << ", guards failed: " << exits << std::endl;
+}
+
+const Expr *While::replay(Context &ctxt) const {
+	auto &&tracer = *ctxt.tracer;
+	auto &&loop = tracer.loops[this];
+	auto base = ctxt.scope_stack.size();
+	if (!loop.root) {
+		if (ctxt.recording || loop.pending || loop.aborts >= Tracer::retries
+			|| ++loop.hits < Tracer::threshold)
+			return expr_.get();
+		// the walker records the next iteration, starting at the condition
+		tracer.record(ctxt, loop, nullptr, base);
+		ctxt.exit_prev = this;
+		ctxt.exit_node = expr_.get();
+		return nullptr;
+	}
+	std::vector<Value *> slots;
+	for (auto &&name : loop.outer) {
+		auto level = base;
+		while (level-- > 0 && !ctxt.scope_stack[level].count(name));
+		if (level == std::size_t(-1))
+			return expr_.get();
+		slots.push_back(&ctxt.scope_stack[level][name]);
+	}
+	// scopes opened by the traces must not move the ones holding the slots
+	ctxt.scope_stack.reserve(base + loop.depth);
+	++tracer.executed;
+	for (auto trace = loop.root.get();;) {
+		for (std::size_t i = 0; i < trace->steps.size(); ++i) {
+			auto &&step = trace->steps[i];
+			if (step.run(ctxt, slots.data()))
+				continue;
+			if (step.branch) {
+				trace = step.branch.get();
+				i = -1;
+				continue;
+			}
+			// leaving the loop at its condition is not a failure
+			if (step.node != this) {
+				++tracer.exits;
+				if (++step.exits == Tracer::threshold && !ctxt.recording && !loop.pending)
+					tracer.record(ctxt, loop, &step, base);
+			}
+			ctxt.exit_prev = step.prev;
+			ctxt.exit_node = step.node;
+			return nullptr;
+		}
+		ctxt.res.pop_back();
+		++tracer.iterations;
+		trace = loop.root.get();
+		if (ctxt.tick()) {
+			ctxt.resume = expr_.get();
+			return nullptr;
+		}
+	}
+}
+
+bool While::record(Trace &tr, Context &ctxt) const {
+	if (tr.loop != &ctxt.tracer->loops[this])
+		return false;
+	if (ctxt.prev == block_.get()) {
+		ctxt.tracer->finish(ctxt);
+		return true;
+	}
+	if (ctxt.prev != expr_.get())
+		return false;
+	Types t = Trace::type(ctxt.res.back());
+	if (!t.bits)
+		return false;
+	// the loop is over before the iteration was seen, the next one is recorded
+	if (!truth(ctxt.res.back(), t)) {
+		ctxt.tracer->cancel(ctxt);
+		return true;
+	}
+	tr.add(ctxt, this, [t](Context &ctxt, Value **slots) {
+		if (!truth(ctxt.res.back(), t))
+			return false;
+		ctxt.res.pop_back();
+		return true;
+	});
+	return true;
+}
+
+bool Empty::record(Trace &tr, Context &ctxt) const {
+	tr.add(ctxt, this, [](Context &ctxt, Value **slots) {
+		ctxt.res.emplace_back();
+		return true;
+	});
+	return true;
+}
+
+bool Scope::record(Trace &tr, Context &ctxt) const {
+	if (ctxt.call_stack.back() == static_cast<const Expr *>(this))
+		tr.add(ctxt, this, [](Context &ctxt, Value **slots) {
+			ctxt.scope_stack.pop_back();
+			ctxt.call_stack.pop_back();
+			return true;
+		});
+	else if (blocks_) {
+		auto &&depth = tr.loop->depth;
+		depth = std::max(depth, ctxt.scope_stack.size() + 1 - tr.base);
+		tr.add(ctxt, this, [this](Context &ctxt, Value **slots) {
+			ctxt.scope_stack.emplace_back();
+			ctxt.call_stack.push_back(this);
+			return true;
+		});
+	} else
+		tr.add(ctxt, this, [](Context &ctxt, Value **slots) {
+			ctxt.res.emplace_back();
+			return true;
+		});
+	return true;
+}
+
+bool Seq::record(Trace &tr, Context &ctxt) const {
+	if (ctxt.prev == fst_.get())
+		tr.add(ctxt, this, [](Context &ctxt, Value **slots) {
+			ctxt.res.pop_back();
+			return true;
+		});
+	return true;
+}
+
+bool If::record(Trace &tr, Context &ctxt) const {
+	if (ctxt.prev != expr_.get())
+		return true;
+	Types t = Trace::type(ctxt.res.back());
+	if (!t.bits)
+		return false;
+	bool flag = truth(ctxt.res.back(), t);
+	bool empty = !flag && !false_block_;
+	tr.add(ctxt, this, [t, flag, empty](Context &ctxt, Value **slots) {
+		if (truth(ctxt.res.back(), t) != flag)
+			return false;
+		ctxt.res.pop_back();
+		if (empty)
+			ctxt.res.emplace_back();
+		return true;
+	});
+	return true;
+}
+
+bool ExprInt::record(Trace &tr, Context &ctxt) const {
+	tr.add(ctxt, this, [loc = loc_, val = val_](Context &ctxt, Value **slots) {
+		ctxt.res.emplace_back(loc, val);
+		return true;
+	});
+	return true;
+}
+
+bool ExprFloat::record(Trace &tr, Context &ctxt) const {
+	tr.add(ctxt, this, [loc = loc_, val = val_](Context &ctxt, Value **slots) {
+		ctxt.res.emplace_back(loc, val);
+		return true;
+	});
+	return true;
+}
+
+namespace {
+template <typename T>
+Trace::Op load(int slot, const std::string &name) {
+	if (slot >= 0)
+		return [slot](Context &ctxt, Value **slots) {
+			auto &&var = *slots[slot];
+			if (!var.isSameType<T>())
+				return false;
+			ctxt.res.push_back(var);
+			return true;
+		};
+	return [&name](Context &ctxt, Value **slots) {
+		for (auto it = ctxt.scope_stack.rbegin(), end = ctxt.scope_stack.rend(); it != end; ++it) {
+			auto var = it->find(name);
+			if (var == it->end())
+				continue;
+			if (!var->second.isSameType<T>())
+				return false;
+			ctxt.res.push_back(var->second);
+			return true;
+		}
+		return false;
+	};
+}
+}
+
+bool ExprId::record(Trace &tr, Context &ctxt) const {
+	const Value *val = nullptr;
+	for (auto it = ctxt.scope_stack.rbegin(), end = ctxt.scope_stack.rend(); it != end && !val; ++it) {
+		auto var = it->find(name_);
+		if (var != it->end())
+			val = &var->second;
+	}
+	unsigned char t = val ? Trace::type(*val) : static_cast<unsigned char>(Types::None);
+	if (t == Types::Int)
+		tr.add(ctxt, this, load<int>(tr.slot(ctxt, name_), name_));
+	else if (t == Types::Double)
+		tr.add(ctxt, this, load<double>(tr.slot(ctxt, name_), name_));
+	return t;
+}
+
+bool ExprList::record(Trace &tr, Context &ctxt) const {
+	return true;
+}
+
+bool ExprApply::record(Trace &tr, Context &ctxt) const {
+	// only calls of intrinsics stay within the loop
+	if (!target_ || !target_->intrinsic_)
+		return false;
+	if (ctxt.prev == parent_)
+		return true;
+	return target_->intrinsic_->record(tr, ctxt, this);
+}
+
+bool ExprAssign::record(Trace &tr, Context &ctxt) const {
+	if (ctxt.prev == parent_)
+		return true;
+	auto slot = tr.slot(ctxt, id_->name_, true);
+	if (slot >= 0)
+		tr.add(ctxt, this, [slot](Context &ctxt, Value **slots) {
+			*slots[slot] = ctxt.res.back();
+			return true;
+		});
+	else
+		tr.add(ctxt, this, [&name = id_->name_](Context &ctxt, Value **slots) {
+			for (auto it = ctxt.scope_stack.rbegin(), end = ctxt.scope_stack.rend(); it != end; ++it) {
+				auto var = it->find(name);
+				if (var != it->end()) {
+					var->second = ctxt.res.back();
+					return true;
+				}
+			}
+			if (auto var = ctxt.import(name))
+				*var = ctxt.res.back();
+			else
+				ctxt.scope_stack.back()[name] = ctxt.res.back();
+			return true;
+		});
+	return true;
+}
+}
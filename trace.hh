@@ -0,0 +1,82 @@
+#pragma once
+#include "value.hh"
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace AST {
+
+struct Context;
+struct Expr;
+struct While;
+struct Traces;
+
+// Straight line form of one iteration of a loop: the steps the walker took
+// with the branches and the types it saw turned into guards
+struct Trace {
+	// false when the guard of the step fails, nothing is changed then
+	using Op = std::function<bool (Context &ctxt, Value **slots)>;
+	struct Step {
+		Op run;
+		// the walker goes on by evaluating node after prev
+		const Expr *prev;
+		const Expr *node;
+		std::size_t exits = 0;
+		// where the loop continues when the guard fails
+		std::unique_ptr<Trace> branch;
+	};
+	std::vector<Step> steps;
+
+	// while the trace is recorded: its loop, the guard it continues and
+	// the scopes below the iteration
+	Traces *loop;
+	Step *anchor;
+	std::size_t base;
+
+	void add(const Context &ctxt, const Expr *node, Op op);
+	// index of the slot of a variable living outside the iteration, -1 otherwise
+	int slot(const Context &ctxt, const std::string &name, bool create = false);
+	static unsigned char type(const Value &val);
+};
+
+// Traces of one loop, the first one starts at the condition and the others
+// at guards of a trace that failed often
+struct Traces {
+	std::size_t hits = 0;
+	unsigned aborts = 0;
+	std::unique_ptr<Trace> root;
+	std::unique_ptr<Trace> pending;
+	// variables the traces find outside the iteration, looked up once per run
+	std::vector<std::string> outer;
+	// scopes the traces open at most
+	std::size_t depth = 0;
+};
+
+// Hot loops of the walker. After a loop went around threshold times one
+// iteration is recorded, later ones replay the trace until a guard fails
+// and the walker takes over where the trace stopped. A guard failing
+// threshold times gets a trace of its own.
+struct Tracer {
+	static constexpr std::size_t threshold = 64;
+	static constexpr unsigned retries = 4;
+	static bool enabled;
+	static bool report;
+
+	std::unordered_map<const While *, Traces> loops;
+	std::size_t recorded = 0;
+	std::size_t aborted = 0;
+	std::size_t executed = 0;
+	std::size_t iterations = 0;
+	std::size_t exits = 0;
+
+	void record(Context &ctxt, Traces &loop, Trace::Step *anchor, std::size_t base);
+	void finish(Context &ctxt);
+	void abort(Context &ctxt);
+	void cancel(Context &ctxt);
+	void print(std::ostream &os) const;
+};
+}
@@ -0,0 +1,149 @@
+#pragma once
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace AST {
+
+struct ExprFunc;
+struct Module;
+
+// Set of the runtime types an expression may produce.
+// Absent is only used for variables: the name may be missing in a scope.
+struct Types {
+	enum : unsigned char {
+		None	= 0,
+		Udef	= 1 << 0,
+		Int	= 1 << 1,
+		Double	= 1 << 2,
+		Func	= 1 << 3,
+		Absent	= 1 << 4,
+	};
+	unsigned char bits = None;
+	// sorted, every node holds one so it is kept smaller than a set
+	std::vector<ExprFunc *> funcs;
+
+	Types(unsigned char b = None) : bits(b) {
+	}
+	explicit Types(ExprFunc *func) : bits(Func), funcs{func} {
+	}
+	bool may(unsigned char b) const {
+		return bits & b;
+	}
+	bool join(const Types &rhs) {
+		auto old_bits = bits;
+		bits |= rhs.bits;
+		if (std::includes(funcs.begin(), funcs.end(), rhs.funcs.begin(), rhs.funcs.end()))
+			return bits != old_bits;
+		std::vector<ExprFunc *> res;
+		std::set_union(funcs.begin(), funcs.end(), rhs.funcs.begin(), rhs.funcs.end(),
+			std::back_inserter(res));
+		funcs = std::move(res);
+		return true;
+	}
+	bool operator == (const Types &rhs) const {
+		return bits == rhs.bits && funcs == rhs.funcs;
+	}
+	bool operator != (const Types &rhs) const {
+		return !(*this == rhs);
+	}
+};
+
+inline std::ostream &operator << (std::ostream &os, const Types &t) {
+	static const char *names[] = {"undef", "int", "double", "func", "absent"};
+	if (t.bits == Types::None)
+		return os << "none";
+	auto sep = "";
+	for (unsigned i = 0; i < sizeof(names) / sizeof(*names); ++i)
+		if (t.bits & (1 << i)) {
+			os << sep << names[i];
+			sep = "|";
+		}
+	return os;
+}
+
+// Result of a numeric operator applied to operands of the given types,
+// mirrors the conversion rules of apply() in value.hh
+inline Types numeric(const Types &l, const Types &r, bool int_only = false) {
+	constexpr auto num = Types::Int | Types::Double;
+	Types res;
+	if (int_only) {
+		if ((l.may(Types::Int) && r.may(num)) || (r.may(Types::Int) && l.may(num)))
+			res.bits |= Types::Int;
+		return res;
+	}
+	if ((l.may(Types::Double) && r.may(num)) || (r.may(Types::Double) && l.may(num)))
+		res.bits |= Types::Double;
+	if (l.may(Types::Int) && r.may(Types::Int))
+		res.bits |= Types::Int;
+	return res;
+}
+
+inline Types numeric(const Types &v, bool int_only = false) {
+	return Types(v.bits & (int_only ? Types::Int : Types::Int | Types::Double));
+}
+
+struct Infer {
+	using VarsT = std::map<std::string, Types>;
+	using EnvT = std::vector<VarsT>;
+	// modules imported so far, false when only on some of the paths
+	using ImportsT = std::vector<std::pair<Module *, bool>>;
+
+	struct State {
+		EnvT env;
+		bool live = true;
+		ImportsT imports;
+		void join(const State &rhs);
+		bool operator == (const State &rhs) const {
+			if (!live || !rhs.live)
+				return live == rhs.live;
+			return env == rhs.env && imports == rhs.imports;
+		}
+	};
+	struct Target {
+		State state{{}, false, {}};
+		Types res;
+	};
+	struct Summary {
+		std::vector<Types> params;
+		VarsT globals;
+		ImportsT imports;
+		VarsT writes;
+		// modules the function imports
+		std::vector<Module *> opened;
+		Types res;
+		unsigned iter = 0;
+		bool called = false;
+		bool active = false;
+	};
+
+	State state;
+	// functions of the builtin modules, names no variable may hold
+	VarsT builtins;
+	std::vector<Target> targets;
+	std::vector<Summary *> frames;
+	std::map<ExprFunc *, Summary> funcs;
+	// results of the tasks, the spawned calls and the program, what a join may give
+	Types tasks;
+	unsigned iter = 0;
+	bool changed = false;
+	// the named functions may also be called by a host program
+	bool open = false;
+
+	static bool join(VarsT &lhs, const VarsT &rhs);
+	static bool join(ImportsT &lhs, const ImportsT &rhs);
+	Types read(const std::string &name) const;
+	Types imported(const std::string &name) const;
+	void write(const std::string &name, const Types &t);
+	void write_global(const std::string &name, const Types &t);
+	void record(const std::string &name, const Types &t);
+	void merge(const VarsT &writes);
+	void import(Module *module, bool certain);
+	void ret(const Types &t);
+	void call_globals();
+};
+}
@@ -91,6 +91,9 @@ public:
 	Val *clone() const override {
 		return new Val(origin_, val_);
 	}
+	T &get() {
+		return val_;
+	}
 	Val(LocT loc, T val) : origin_(loc), val_(val) {
 	}
 };
@@ -213,6 +216,10 @@ public:
 		return operator int();
 	}
 	template <typename T>
+	T &get() & {
+		return static_cast<Values::Val<T> *>(ptr_)->get();
+	}
+	template <typename T>
 	bool isSameType() const {
 		return typeid(*ptr_) == typeid(Values::Val<T>);
 	}